@@ -0,0 +1,392 @@
+#define _POSIX_C_SOURCE 200809L
+#ifdef __linux__
+#define _DEFAULT_SOURCE  // for syscall()
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "game.h"
+#include "game_aux.h"
+#include "game_ext.h"
+#include "game_tools.h"
+#include "prng.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* Each benchmark is run on a solved random game of each size, with and without
+ * wrapping. After a warm-up, it is repeated until it has run for about
+ * TARGET_TIME seconds (between MIN_REPS and MAX_REPS times), and the median,
+ * 99th percentile and minimum of the repetitions are reported in JSON, as the
+ * time of a single operation. Cheap operations are run several times within a
+ * repetition, so that each repetition is long enough to be timed.
+ *
+ * With --counters, the hardware counters of the CPU (cycles, instructions,
+ * cache misses and branch mispredictions) are read around the same regions as
+ * the time, with perf_event_open on Linux, and reported per operation as well.
+ * The counters that cannot be opened (other systems, no PMU in a virtual
+ * machine, perf_event_paranoid too high...) are reported as null. */
+
+#define SEED 40
+#define WARMUP_TIME 0.05
+#define TARGET_TIME 0.3
+#define MIN_REPS 5
+#define MAX_REPS 1000
+#define BENCH_FILE "bench_game.tmp"
+
+/* ************************************************************************** */
+/*                             HARDWARE COUNTERS                              */
+/* ************************************************************************** */
+
+typedef enum { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, NB_COUNTERS } counter;
+
+static const char* _counter_names[NB_COUNTERS] = {"cycles", "instructions", "l1d_misses", "llc_misses",
+                                                  "branch_misses"};
+
+/* file descriptors of the counters (-1 if unavailable), all in the group of
+ * the first available one, so that they are enabled and disabled together */
+static int _counter_fds[NB_COUNTERS] = {-1, -1, -1, -1, -1};
+static int _counter_leader = -1;
+
+#ifdef __linux__
+static int _perf_event_open(uint32_t type, uint64_t config, int group_fd) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = (group_fd == -1);  // the leader starts the whole group
+  attr.exclude_kernel = 1;           // allowed with perf_event_paranoid <= 2
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+/** open the counters, return the number of available ones */
+static uint _counters_open(void) {
+  uint nb = 0;
+#ifdef __linux__
+  static const struct {
+    uint32_t type;
+    uint64_t config;
+  } events[NB_COUNTERS] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {PERF_TYPE_HW_CACHE,
+       PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  };
+  for (uint c = 0; c < NB_COUNTERS; c++) {
+    _counter_fds[c] = _perf_event_open(events[c].type, events[c].config, _counter_leader);
+    if (_counter_fds[c] < 0) {
+      _counter_fds[c] = -1;
+      continue;
+    }
+    if (_counter_leader == -1) _counter_leader = _counter_fds[c];
+    nb++;
+  }
+#endif
+  return nb;
+}
+
+static void _counters_close(void) {
+#ifdef __linux__
+  for (uint c = 0; c < NB_COUNTERS; c++)
+    if (_counter_fds[c] != -1) close(_counter_fds[c]);
+#endif
+}
+
+static void _counters_start(void) {
+#ifdef __linux__
+  if (_counter_leader == -1) return;
+  ioctl(_counter_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(_counter_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+/** stop the counters, and add their values to counts */
+static void _counters_stop(double counts[NB_COUNTERS]) {
+#ifdef __linux__
+  if (_counter_leader == -1) return;
+  ioctl(_counter_leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  for (uint c = 0; c < NB_COUNTERS; c++) {
+    uint64_t v[3];  // value, time enabled, time running
+    if (_counter_fds[c] == -1 || read(_counter_fds[c], v, sizeof(v)) != sizeof(v)) continue;
+    // scale the value if the group has been multiplexed with other events
+    counts[c] += (v[2] > 0 && v[2] < v[1]) ? (double)v[0] * v[1] / v[2] : (double)v[0];
+  }
+#endif
+}
+
+/* ************************************************************************** */
+
+typedef struct {
+  game g; /* a solved game */
+  uint nb_rows, nb_cols;
+  bool wrapping;
+  uint inner; /* number of operations in a repetition, for the O(size) ones */
+  prng rng;
+  /* measured regions */
+  bool counters;              /* read the hardware counters */
+  double start;               /* start time of the current region */
+  double counts[NB_COUNTERS]; /* counter totals since the last reset */
+  uint64_t nb_ops;            /* number of operations since the last reset */
+} bench;
+
+/** a benchmark runs one repetition, and returns the time of one operation */
+typedef double (*bench_fn)(bench* b);
+
+static double _now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* keep the results alive, so that the compiler does not drop the calls */
+static volatile bool _sink;
+
+/** start a measured region */
+static void _begin(bench* b) {
+  if (b->counters) _counters_start();
+  b->start = _now();
+}
+
+/** end a measured region of nb_ops operations, return the time of one */
+static double _end(bench* b, uint nb_ops) {
+  double elapsed = _now() - b->start;
+  if (b->counters) _counters_stop(b->counts);
+  b->nb_ops += nb_ops;
+  return elapsed / nb_ops;
+}
+
+/* ************************************************************************** */
+/*                                 BENCHMARKS                                 */
+/* ************************************************************************** */
+
+static double _bench_won(bench* b) {
+  _begin(b);
+  for (uint k = 0; k < b->inner; k++) _sink = game_won(b->g);
+  return _end(b, b->inner);
+}
+
+static double _bench_well_paired(bench* b) {
+  _begin(b);
+  for (uint k = 0; k < b->inner; k++) _sink = game_is_well_paired(b->g);
+  return _end(b, b->inner);
+}
+
+static double _bench_connected(bench* b) {
+  _begin(b);
+  for (uint k = 0; k < b->inner; k++) _sink = game_is_connected(b->g);
+  return _end(b, b->inner);
+}
+
+/* a move, then its undo and redo, on random squares, played on a copy so that
+ * the history does not grow from one repetition to the next */
+#define NB_MOVES 1024
+
+static double _bench_move_undo_redo(bench* b) {
+  uint pos[NB_MOVES];
+  for (uint k = 0; k < NB_MOVES; k++) pos[k] = prng_next(&b->rng) % (b->nb_rows * b->nb_cols);
+  game g = game_copy(b->g);
+  _begin(b);
+  for (uint k = 0; k < NB_MOVES; k++) {
+    game_play_move(g, pos[k] / b->nb_cols, pos[k] % b->nb_cols, 1);
+    game_undo(g);
+    game_redo(g);
+  }
+  double elapsed = _end(b, NB_MOVES);
+  game_delete(g);
+  return elapsed;
+}
+
+static double _bench_copy(bench* b) {
+  _begin(b);
+  game copy = game_copy(b->g);
+  double elapsed = _end(b, 1);
+  game_delete(copy);
+  return elapsed;
+}
+
+static double _bench_save(bench* b) {
+  _begin(b);
+  bool ok = game_save(b->g, BENCH_FILE);
+  double elapsed = _end(b, 1);
+  if (!ok) {
+    fprintf(stderr, "Error: Cannot write %s.\n", BENCH_FILE);
+    exit(EXIT_FAILURE);
+  }
+  return elapsed;
+}
+
+static double _bench_load(bench* b) {
+  _begin(b);
+  game g = game_load(BENCH_FILE);
+  double elapsed = _end(b, 1);
+  if (g == NULL) {
+    fprintf(stderr, "Error: Cannot load %s.\n", BENCH_FILE);
+    exit(EXIT_FAILURE);
+  }
+  game_delete(g);
+  return elapsed;
+}
+
+static double _bench_random(bench* b) {
+  _begin(b);
+  game g = game_random(b->nb_rows, b->nb_cols, b->wrapping, 0, 0);
+  double elapsed = _end(b, 1);
+  game_delete(g);
+  return elapsed;
+}
+
+static double _bench_shuffle(bench* b) {
+  game g = game_copy(b->g);
+  _begin(b);
+  game_shuffle_orientation(g);
+  double elapsed = _end(b, 1);
+  game_delete(g);
+  return elapsed;
+}
+
+static const struct {
+  const char* name;
+  bench_fn fn;
+} _benchmarks[] = {
+    {"game_won", _bench_won},
+    {"game_is_well_paired", _bench_well_paired},
+    {"game_is_connected", _bench_connected},
+    {"game_play_move+undo+redo", _bench_move_undo_redo},
+    {"game_copy", _bench_copy},
+    {"game_save", _bench_save},
+    {"game_load", _bench_load},
+    {"game_random", _bench_random},
+    {"game_shuffle_orientation", _bench_shuffle},
+};
+
+#define NB_BENCHMARKS (sizeof(_benchmarks) / sizeof(_benchmarks[0]))
+
+/* ************************************************************************** */
+
+static int _compare(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/** run a benchmark and print its result as a JSON object */
+static void _run(bench* b, uint n, bool first) {
+  bench_fn fn = _benchmarks[n].fn;
+  // warm-up, which also estimates the time of a repetition
+  uint nb_warmup = 0;
+  double start = _now();
+  do {
+    fn(b);
+    nb_warmup++;
+  } while (_now() - start < WARMUP_TIME);
+  double rep_time = (_now() - start) / nb_warmup;
+  double reps = rep_time > 0 ? TARGET_TIME / rep_time : MAX_REPS;
+  uint nb_reps = reps < MIN_REPS ? MIN_REPS : reps > MAX_REPS ? MAX_REPS : (uint)reps;
+
+  double* samples = malloc(nb_reps * sizeof(double));
+  if (samples == NULL) {
+    fprintf(stderr, "Error: Not enough memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  memset(b->counts, 0, sizeof(b->counts));
+  b->nb_ops = 0;
+  double sum = 0;
+  for (uint r = 0; r < nb_reps; r++) {
+    samples[r] = fn(b);
+    sum += samples[r];
+  }
+  qsort(samples, nb_reps, sizeof(double), _compare);
+  uint p99 = (99 * nb_reps + 99) / 100 - 1;  // nearest rank
+  printf("%s    {\"name\": \"%s\", \"rows\": %u, \"cols\": %u, \"wrapping\": %s, \"reps\": %u, ", first ? "" : ",\n",
+         _benchmarks[n].name, b->nb_rows, b->nb_cols, b->wrapping ? "true" : "false", nb_reps);
+  printf("\"median_ns\": %.1f, \"p99_ns\": %.1f, \"min_ns\": %.1f, \"mean_ns\": %.1f", 1e9 * samples[nb_reps / 2],
+         1e9 * samples[p99], 1e9 * samples[0], 1e9 * sum / nb_reps);
+  if (b->counters) {
+    // counters per operation, averaged over all the repetitions
+    printf(", \"counters\": {");
+    for (uint c = 0; c < NB_COUNTERS; c++) {
+      printf("%s\"%s\": ", c ? ", " : "", _counter_names[c]);
+      if (_counter_fds[c] == -1)
+        printf("null");
+      else
+        printf("%.1f", b->counts[c] / b->nb_ops);
+    }
+    printf("}");
+  }
+  printf("}");
+  fflush(stdout);
+  free(samples);
+}
+
+/* ************************************************************************** */
+
+void usage(char* cmd) {
+  printf("Usage: %s [--max-size <n>] [--filter <name>] [--counters]\n", cmd);
+  printf("Times the core functions on n x n games, n going from 5 to 4096 (or <n>), and prints the\n");
+  printf("results in JSON. With --filter, only the functions whose name contains <name> are timed.\n");
+  printf("With --counters, the hardware counters (cycles, instructions, L1d and LLC misses, branch\n");
+  printf("mispredictions) are reported per operation too, or null when they are not available.\n");
+  printf("Example: %s --max-size 256 > bench.json\n", cmd);
+}
+
+int main(int argc, char* argv[]) {
+  static const uint sizes[] = {5, 16, 64, 256, 1024, 4096};
+  uint max_size = 4096;
+  char* filter = NULL;
+  bool counters = false;
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--max-size") == 0 && arg + 1 < argc) {
+      max_size = strtoul(argv[++arg], NULL, 10);
+    } else if (strcmp(argv[arg], "--filter") == 0 && arg + 1 < argc) {
+      filter = argv[++arg];
+    } else if (strcmp(argv[arg], "--counters") == 0) {
+      counters = true;
+    } else {
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (counters && _counters_open() == 0)
+    fprintf(stderr, "Warning: No hardware counter available, they are reported as null.\n");
+  printf("{\n  \"benchmark\": \"bench_game\",\n  \"version\": 1,\n  \"seed\": %u,\n", SEED);
+  printf("  \"time\": %lld,\n  \"results\": [\n", (long long)time(NULL));
+  bool first = true;
+  for (uint s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && sizes[s] <= max_size; s++)
+    for (uint wrapping = 0; wrapping < 2; wrapping++) {
+      bench b = {.nb_rows = sizes[s], .nb_cols = sizes[s], .wrapping = wrapping, .counters = counters};
+      prng_seed(&b.rng, SEED);
+      srand(SEED);
+      b.g = game_random_ext(b.nb_rows, b.nb_cols, b.wrapping, 0, 0, &b.rng);
+      b.inner = 1 + 4096 / (b.nb_rows * b.nb_cols);
+      // the file read by game_load
+      if (!game_save(b.g, BENCH_FILE)) {
+        fprintf(stderr, "Error: Cannot write %s.\n", BENCH_FILE);
+        exit(EXIT_FAILURE);
+      }
+      for (uint n = 0; n < NB_BENCHMARKS; n++) {
+        if (filter && !strstr(_benchmarks[n].name, filter)) continue;
+        _run(&b, n, first);
+        first = false;
+      }
+      game_delete(b.g);
+    }
+  printf("\n  ]\n}\n");
+  remove(BENCH_FILE);
+  if (counters) _counters_close();
+  return EXIT_SUCCESS;
+}
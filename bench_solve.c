@@ -0,0 +1,387 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "game_aux.h"
+#include "game_ext.h"
+#include "game_pack.h"
+#include "game_tools.h"
+#include "prng.h"
+
+/* The corpus is made of one shuffled random game for each size from 4x4 to
+ * 30x30, with and without wrapping, empty squares and extra edges (which make
+ * loops). Each game is drawn from its own generator, seeded with SEED + its
+ * index, so that the corpus is the same on every machine. It is stored in a
+ * pack, with the generated game as reference solution, and the expected
+ * results (the number of solutions, counted up to COUNT_LIMIT) are written in a
+ * text file next to it.
+ *
+ * Each solver call runs in a child process, killed by an alarm when it exceeds
+ * the time limit. The child checks its own result and sends it to the parent
+ * through a pipe. */
+
+#define SEED 42
+#define TIME_LIMIT 10
+#define COUNT_LIMIT 1000
+#define UNKNOWN -1L
+
+static const uint _sizes[] = {4, 5, 6, 8, 10, 12, 16, 20, 25, 30};
+
+#define NB_SIZES (sizeof(_sizes) / sizeof(_sizes[0]))
+#define CORPUS_SIZE (NB_SIZES * 8)
+
+/** parameters of the k-th game of the corpus */
+typedef struct {
+  uint nb_rows, nb_cols;
+  bool wrapping;
+  uint nb_empty, nb_extra;
+  uint64_t seed;
+  long nb_solutions; /* expected number of solutions (UNKNOWN if not counted) */
+  bool capped;       /* at least nb_solutions */
+} instance;
+
+static void _corpus_instance(uint k, instance* in) {
+  uint n = _sizes[k / 8];
+  *in = (instance){.nb_rows = n,
+                   .nb_cols = n,
+                   .wrapping = k & 1,
+                   .nb_empty = (k & 2) ? n * n / 10 : 0,
+                   .nb_extra = (k & 4) ? n : 0,
+                   .seed = SEED + k,
+                   .nb_solutions = UNKNOWN};
+}
+
+static double _now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ************************************************************************** */
+/*                             TIME-LIMITED RUNS                              */
+/* ************************************************************************** */
+
+typedef enum { RUN_OK, RUN_WRONG, RUN_TIMEOUT, RUN_ERROR } run_status;
+
+static const char* _status_names[] = {"ok", "WRONG", "timeout", "ERROR"};
+
+/** what a child sends back to its parent */
+typedef struct {
+  bool ok;       /* the result is correct */
+  uint nb;       /* number of solutions found */
+  uint nb_nodes; /* solver nodes */
+  double time;   /* time of the solver call */
+} result;
+
+typedef struct {
+  cgame g;
+  const instance* in; /* expected results, or NULL */
+} job;
+
+typedef void (*job_fn)(const job* j, result* r);
+
+/** solve a copy of the game, and check the solution */
+static void _job_solve(const job* j, result* r) {
+  game g = game_copy(j->g);
+  game_stats stats;
+  double start = _now();
+  bool found = game_solve_ext(g, &stats);
+  r->time = _now() - start;
+  r->nb = found;
+  r->nb_nodes = stats.nb_nodes;
+  // every game of the corpus has a solution: the generated game
+  r->ok = found && game_equal(j->g, g, true) && game_won(g);
+  game_delete(g);
+}
+
+/** count the solutions, and compare with the expected number */
+static void _job_count(const job* j, result* r) {
+  game_stats stats;
+  double start = _now();
+  uint nb = game_nb_solutions_ext(j->g, COUNT_LIMIT, &stats);
+  r->time = _now() - start;
+  r->nb = nb;
+  r->nb_nodes = stats.nb_nodes;
+  long expected = j->in ? j->in->nb_solutions : UNKNOWN;
+  r->ok = nb > 0 && (expected == UNKNOWN || (long)nb == expected);
+}
+
+/** run a job in a child process, killed after time_limit seconds */
+static run_status _run_limited(job_fn fn, const job* j, uint time_limit, result* r) {
+  int fds[2];
+  if (pipe(fds) != 0) return RUN_ERROR;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return RUN_ERROR;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    alarm(time_limit);
+    result res = {0};
+    fn(j, &res);
+    _exit(write(fds[1], &res, sizeof(res)) == sizeof(res) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  close(fds[1]);
+  size_t nb_read = 0;
+  ssize_t n;
+  while (nb_read < sizeof(result) && (n = read(fds[0], (char*)r + nb_read, sizeof(result) - nb_read)) > 0)
+    nb_read += n;
+  close(fds[0]);
+  int status;
+  while (waitpid(pid, &status, 0) < 0)
+    ;
+  if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM) return RUN_TIMEOUT;
+  if (nb_read != sizeof(result) || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) return RUN_ERROR;
+  return r->ok ? RUN_OK : RUN_WRONG;
+}
+
+/* ************************************************************************** */
+/*                              EXPECTED RESULTS                              */
+/* ************************************************************************** */
+
+static bool _save_expected(char* filename, const instance* ins, uint nb) {
+  FILE* f = fopen(filename, "w");
+  if (f == NULL) return false;
+  fprintf(f, "# bench_solve corpus: index rows cols wrapping empty extra seed solutions (+ = at least, ? = unknown)\n");
+  for (uint k = 0; k < nb; k++) {
+    const instance* in = &ins[k];
+    fprintf(f, "%u %u %u %d %u %u %llu ", k, in->nb_rows, in->nb_cols, in->wrapping, in->nb_empty, in->nb_extra,
+            (unsigned long long)in->seed);
+    if (in->nb_solutions == UNKNOWN)
+      fprintf(f, "?\n");
+    else
+      fprintf(f, "%ld%s\n", in->nb_solutions, in->capped ? "+" : "");
+  }
+  return fclose(f) == 0;
+}
+
+/** read the expected results, return the number of instances or -1 on error */
+static int _load_expected(char* filename, instance* ins, uint max) {
+  FILE* f = fopen(filename, "r");
+  if (f == NULL) return -1;
+  char line[256];
+  uint nb = 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+    uint k, wrapping;
+    unsigned long long seed;
+    char sols[32];
+    instance in = {0};
+    if (sscanf(line, "%u %u %u %u %u %u %llu %31s", &k, &in.nb_rows, &in.nb_cols, &wrapping, &in.nb_empty,
+               &in.nb_extra, &seed, sols) != 8 ||
+        k != nb || nb >= max) {
+      fclose(f);
+      return -1;
+    }
+    in.wrapping = wrapping;
+    in.seed = seed;
+    if (sols[0] == '?') {
+      in.nb_solutions = UNKNOWN;
+    } else {
+      char* end;
+      in.nb_solutions = strtol(sols, &end, 10);
+      in.capped = (*end == '+');
+    }
+    ins[nb++] = in;
+  }
+  fclose(f);
+  return nb;
+}
+
+/* ************************************************************************** */
+/*                                 GENERATION                                 */
+/* ************************************************************************** */
+
+static int _generate(char* corpus_file, char* expected_file, uint time_limit) {
+  pack_writer w = pack_writer_open(corpus_file);
+  if (w == NULL) {
+    fprintf(stderr, "Error: Cannot write %s.\n", corpus_file);
+    return EXIT_FAILURE;
+  }
+  instance ins[CORPUS_SIZE];
+  bool ok = true;
+  for (uint k = 0; k < CORPUS_SIZE && ok; k++) {
+    instance* in = &ins[k];
+    _corpus_instance(k, in);
+    prng rng;
+    prng_seed(&rng, in->seed);
+    game solution = game_random_ext(in->nb_rows, in->nb_cols, in->wrapping, in->nb_empty, in->nb_extra, &rng);
+    if (solution == NULL) {
+      fprintf(stderr, "Error: Cannot generate game %u.\n", k);
+      ok = false;
+      break;
+    }
+    game g = game_copy(solution);
+    game_shuffle_orientation_ext(g, &rng);
+    // count the solutions with the current solver, as for a benchmark run
+    job j = {.g = g};
+    result r;
+    if (_run_limited(_job_count, &j, time_limit, &r) == RUN_OK) {
+      in->nb_solutions = r.nb;
+      in->capped = (r.nb >= COUNT_LIMIT);
+    }
+    printf("%3u %2ux%-2u wrapping=%d empty=%-3u extra=%-2u solutions=", k, in->nb_rows, in->nb_cols, in->wrapping,
+           in->nb_empty, in->nb_extra);
+    if (in->nb_solutions == UNKNOWN)
+      printf("?\n");
+    else
+      printf("%ld%s\n", in->nb_solutions, in->capped ? "+" : "");
+    ok = pack_writer_add(w, g, solution);
+    game_delete(g);
+    game_delete(solution);
+  }
+  if (!pack_writer_close(w) || !ok) {
+    fprintf(stderr, "Error: Cannot write %s.\n", corpus_file);
+    return EXIT_FAILURE;
+  }
+  if (!_save_expected(expected_file, ins, CORPUS_SIZE)) {
+    fprintf(stderr, "Error: Cannot write %s.\n", expected_file);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+/*                                 BENCHMARK                                  */
+/* ************************************************************************** */
+
+typedef struct {
+  const char* name;
+  uint nb_status[RUN_ERROR + 1];
+  double time; /* total time of the completed runs */
+} score;
+
+static void _print_score(const score* s, uint nb) {
+  printf("%-17s %3u ok, %3u wrong, %3u timed out, %3u errors / %u, total time %.3f s\n", s->name,
+         s->nb_status[RUN_OK], s->nb_status[RUN_WRONG], s->nb_status[RUN_TIMEOUT], s->nb_status[RUN_ERROR], nb,
+         s->time);
+}
+
+/** run a job and print its column of results */
+static void _bench(job_fn fn, const job* j, uint time_limit, score* s) {
+  result r;
+  run_status st = _run_limited(fn, j, time_limit, &r);
+  s->nb_status[st]++;
+  if (st == RUN_OK || st == RUN_WRONG) {
+    s->time += r.time;
+    printf(" | %-7s %10.6f %9u %5u", _status_names[st], r.time, r.nb_nodes, r.nb);
+  } else {
+    printf(" | %-7s %10s %9s %5s", _status_names[st], "-", "-", "-");
+  }
+}
+
+static int _benchmark(char* corpus_file, char* expected_file, uint time_limit, bool count) {
+  pack p = pack_open(corpus_file);
+  if (p == NULL) {
+    fprintf(stderr, "Error: Cannot open %s.\n", corpus_file);
+    return EXIT_FAILURE;
+  }
+  uint nb = pack_count(p);
+  instance* ins = NULL;
+  if (expected_file) {
+    ins = malloc(nb * sizeof(instance));
+    if (ins == NULL || _load_expected(expected_file, ins, nb) != (int)nb) {
+      fprintf(stderr, "Error: Invalid expected results %s for %u games.\n", expected_file, nb);
+      free(ins);
+      pack_close(p);
+      return EXIT_FAILURE;
+    }
+  }
+
+  score solve = {.name = "game_solve"}, nb_solutions = {.name = "game_nb_solutions"};
+  uint nb_invalid = 0;
+  printf("  id  size wrap | solve       seconds     nodes  sols%s\n",
+         count ? " | count       seconds     nodes  sols expected" : "");
+  for (uint k = 0; k < nb; k++) {
+    game g = pack_get(p, k);
+    game solution = pack_get_solution(p, k);
+    // the reference solution must solve the game, and the expected results must be the ones of this corpus
+    const instance* in = ins ? &ins[k] : NULL;
+    if (g == NULL || solution == NULL || !game_equal(g, solution, true) || !game_won(solution) ||
+        (in && (game_nb_rows(g) != in->nb_rows || game_nb_cols(g) != in->nb_cols ||
+                game_is_wrapping(g) != in->wrapping))) {
+      printf("%4u invalid record\n", k);
+      nb_invalid++;
+      if (g) game_delete(g);
+      if (solution) game_delete(solution);
+      continue;
+    }
+    job j = {.g = g, .in = in};
+    printf("%4u %2ux%-2u %-4s", k, game_nb_rows(g), game_nb_cols(g), game_is_wrapping(g) ? "yes" : "no");
+    _bench(_job_solve, &j, time_limit, &solve);
+    if (count) {
+      _bench(_job_count, &j, time_limit, &nb_solutions);
+      if (in == NULL || in->nb_solutions == UNKNOWN)
+        printf(" %8s", "?");
+      else
+        printf(" %7ld%s", in->nb_solutions, in->capped ? "+" : " ");
+    }
+    printf("\n");
+    game_delete(g);
+    game_delete(solution);
+  }
+
+  printf("\n%u games (time limit %u s, solutions counted up to %u)\n", nb, time_limit, COUNT_LIMIT);
+  _print_score(&solve, nb);
+  if (count) _print_score(&nb_solutions, nb);
+  free(ins);
+  pack_close(p);
+  bool ok = nb_invalid == 0 && solve.nb_status[RUN_WRONG] == 0 && solve.nb_status[RUN_ERROR] == 0 &&
+            nb_solutions.nb_status[RUN_WRONG] == 0 && nb_solutions.nb_status[RUN_ERROR] == 0;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* ************************************************************************** */
+
+void usage(char* cmd) {
+  printf("Usage: %s --generate <corpus.pack> <expected.txt> [--time-limit <s>]\n", cmd);
+  printf("       %s [--time-limit <s>] [--no-count] <corpus.pack> [<expected.txt>]\n", cmd);
+  printf("The first form generates the corpus: %u shuffled random games from 4x4 to 30x30, with and without\n",
+         (uint)CORPUS_SIZE);
+  printf("wrapping, empty squares and extra edges, stored with their solution, and their expected number of\n");
+  printf("solutions. The second form runs game_solve and game_nb_solutions on each game of a pack, each\n");
+  printf("call being stopped after <s> seconds (default %u), checks the results and prints a scoreboard.\n",
+         TIME_LIMIT);
+  printf("The expected results of the corpus, as recorded with the current solver, are in bench_solve.expected.\n");
+  printf("Example: %s --generate corpus.pack corpus.txt && %s corpus.pack bench_solve.expected\n", cmd, cmd);
+}
+
+int main(int argc, char* argv[]) {
+  uint time_limit = TIME_LIMIT;
+  bool generate = false, count = true;
+  char* files[2] = {NULL, NULL};
+  uint nb_files = 0;
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--generate") == 0) {
+      generate = true;
+    } else if (strcmp(argv[arg], "--time-limit") == 0 && arg + 1 < argc) {
+      time_limit = strtoul(argv[++arg], NULL, 10);
+    } else if (strcmp(argv[arg], "--no-count") == 0) {
+      count = false;
+    } else if (argv[arg][0] != '-' && nb_files < 2) {
+      files[nb_files++] = argv[arg];
+    } else {
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (time_limit == 0 || nb_files == 0 || (generate && (nb_files != 2 || !count))) {
+    usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  if (generate) return _generate(files[0], files[1], time_limit);
+  return _benchmark(files[0], files[1], time_limit, count);
+}
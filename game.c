@@ -3,16 +3,21 @@
  * @copyright University of Bordeaux. All rights reserved, 2024.
  **/
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "game.h"
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include "game_aux.h"
 #include "game_ext.h"
+#include "game_journal.h"
 #include "game_private.h"
 #include "game_struct.h"
 #include "queue.h"
@@ -61,10 +66,14 @@ bool game_equal(cgame g1, cgame g2, bool ignore_orientation) {
 
 void game_delete(game g) {
   if (!g) return;
-  free(g->squares);
-  queue_free_full(g->undo_stack, free);
-  queue_free_full(g->redo_stack, free);
-  free(g);
+  game_journal_stop(g);
+  if (g->map)
+    munmap(g->map, g->map_size);  // the squares live in the mapped file
+  else
+    _game_free(g->squares);
+  queue_free_full(g->undo_stack, _game_free);
+  queue_free_full(g->redo_stack, _game_free);
+  _game_free(g);
 }
 
 /* ************************************************************************** */
@@ -121,10 +130,11 @@ void game_play_move(game g, uint i, uint j, int nb_quarter_turns) {
   direction new = MODULO(old + nb_quarter_turns, NB_DIRS);
   ORIENTATION(g, i, j) = new;
 
-  // save history
-  _stack_clear(g->redo_stack);
+  // save history, recycling the elements of the redo stack
   move m = {i, j, old, new};
-  _stack_push_move(g->undo_stack, m);
+  _stack_push_move_from(g->undo_stack, g->redo_stack, m);
+  _stack_clear(g->redo_stack);
+  _journal_move(g, i, j, new);
 }
 
 /* ************************************************************************** */
@@ -138,22 +148,17 @@ void game_reset_orientation(game g) {
   // reset history
   _stack_clear(g->undo_stack);
   _stack_clear(g->redo_stack);
+  _journal_reset(g);
 }
 
 /* ************************************************************************** */
 
 void game_shuffle_orientation(game g) {
   assert(g);
-
-  for (uint i = 0; i < g->nb_rows; i++)
-    for (uint j = 0; j < g->nb_cols; j++) {
-      direction o = rand() % NB_DIRS;
-      game_set_piece_orientation(g, i, j, o);
-    }
-
-  // reset history
-  _stack_clear(g->undo_stack);
-  _stack_clear(g->redo_stack);
+  // draw the seed from rand(), so that srand() still makes the result reproducible
+  prng rng;
+  prng_seed(&rng, ((uint64_t)rand() << 32) ^ (uint64_t)rand());
+  game_shuffle_orientation_ext(g, &rng);
 }
 
 /* ************************************************************************** */
@@ -0,0 +1,114 @@
+/**
+ * @file game_alloc.c
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#include "game_alloc.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_private.h"
+
+/* Each block starts with a header holding its size and subsystem, so that
+ * _game_free() can update the counters and give the size to the free hook. The
+ * header takes ALLOC_HEADER_SIZE bytes, to keep the blocks aligned. The
+ * counters are updated with relaxed atomic operations, since the library may
+ * be used by several threads (game_random, game_solve). */
+
+#define ALLOC_HEADER_SIZE 16
+
+typedef struct {
+  size_t size;
+  uint32_t subsystem;
+} alloc_header;
+
+static void* _default_alloc(size_t size, void* data) { return malloc(size); }
+
+static void _default_free(void* ptr, size_t size, void* data) { free(ptr); }
+
+static game_allocator _allocator = {_default_alloc, _default_free, NULL};
+
+static struct {
+  uint64_t nb_allocs, nb_frees;
+  size_t live_bytes;
+} _stats[NB_ALLOC_SUBSYSTEMS];
+
+/* ************************************************************************** */
+
+void game_set_allocator(const game_allocator* allocator) {
+  for (uint s = 0; s < NB_ALLOC_SUBSYSTEMS; s++) assert(__atomic_load_n(&_stats[s].live_bytes, __ATOMIC_RELAXED) == 0);
+  if (allocator) {
+    assert(allocator->alloc && allocator->free);
+    _allocator = *allocator;
+  } else {
+    _allocator = (game_allocator){_default_alloc, _default_free, NULL};
+  }
+}
+
+/* ************************************************************************** */
+
+void game_get_alloc_stats(alloc_subsystem subsystem, game_alloc_stats* stats) {
+  assert(subsystem < NB_ALLOC_SUBSYSTEMS && stats);
+  stats->nb_allocs = __atomic_load_n(&_stats[subsystem].nb_allocs, __ATOMIC_RELAXED);
+  stats->nb_frees = __atomic_load_n(&_stats[subsystem].nb_frees, __ATOMIC_RELAXED);
+  stats->live_bytes = __atomic_load_n(&_stats[subsystem].live_bytes, __ATOMIC_RELAXED);
+}
+
+/* ************************************************************************** */
+
+void game_reset_alloc_stats(void) {
+  for (uint s = 0; s < NB_ALLOC_SUBSYSTEMS; s++) {
+    __atomic_store_n(&_stats[s].nb_allocs, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&_stats[s].nb_frees, 0, __ATOMIC_RELAXED);
+  }
+}
+
+/* ************************************************************************** */
+/*                              LIBRARY ROUTINES                              */
+/* ************************************************************************** */
+
+void* _game_malloc(alloc_subsystem subsystem, size_t size) {
+  assert(subsystem < NB_ALLOC_SUBSYSTEMS);
+  if (size > SIZE_MAX - ALLOC_HEADER_SIZE) return NULL;
+  alloc_header* h = _allocator.alloc(ALLOC_HEADER_SIZE + size, _allocator.data);
+  if (h == NULL) return NULL;
+  h->size = size;
+  h->subsystem = subsystem;
+  __atomic_fetch_add(&_stats[subsystem].nb_allocs, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&_stats[subsystem].live_bytes, size, __ATOMIC_RELAXED);
+  return (char*)h + ALLOC_HEADER_SIZE;
+}
+
+/* ************************************************************************** */
+
+void* _game_calloc(alloc_subsystem subsystem, size_t nb, size_t size) {
+  if (size > 0 && nb > SIZE_MAX / size) return NULL;
+  void* ptr = _game_malloc(subsystem, nb * size);
+  if (ptr) memset(ptr, 0, nb * size);
+  return ptr;
+}
+
+/* ************************************************************************** */
+
+void* _game_realloc(alloc_subsystem subsystem, void* ptr, size_t size) {
+  if (ptr == NULL) return _game_malloc(subsystem, size);
+  alloc_header* h = (alloc_header*)((char*)ptr - ALLOC_HEADER_SIZE);
+  void* new_ptr = _game_malloc(h->subsystem, size);
+  if (new_ptr == NULL) return NULL;
+  memcpy(new_ptr, ptr, h->size < size ? h->size : size);
+  _game_free(ptr);
+  return new_ptr;
+}
+
+/* ************************************************************************** */
+
+void _game_free(void* ptr) {
+  if (ptr == NULL) return;
+  alloc_header* h = (alloc_header*)((char*)ptr - ALLOC_HEADER_SIZE);
+  __atomic_fetch_add(&_stats[h->subsystem].nb_frees, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_sub(&_stats[h->subsystem].live_bytes, h->size, __ATOMIC_RELAXED);
+  _allocator.free(h, ALLOC_HEADER_SIZE + h->size, _allocator.data);
+}
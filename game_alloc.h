@@ -0,0 +1,79 @@
+/**
+ * @file game_alloc.h
+ * @brief Memory allocation of the library.
+ * @details Every block allocated by the library goes through an allocator,
+ * which is malloc/free by default and can be replaced by custom hooks (an
+ * arena, a pool...). The allocations are counted per subsystem, so that a
+ * program can check how much memory each part of the library holds, or that
+ * some code path does not allocate at all.
+ *
+ * The buffers that are returned to the caller to be released with free()
+ * (see @ref game_save_to_buffer) are not allocated through the allocator.
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#ifndef __GAME_ALLOC_H__
+#define __GAME_ALLOC_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The subsystems of the library, for the allocation counters.
+ **/
+typedef enum {
+  ALLOC_GAME,      /**< games and their squares */
+  ALLOC_HISTORY,   /**< moves of the undo and redo history */
+  ALLOC_QUEUE,     /**< queues and their elements */
+  ALLOC_CHECK,     /**< temporary buffers of the game checks (connectivity) */
+  ALLOC_SOLVER,    /**< solver state */
+  ALLOC_GENERATOR, /**< random game generation */
+  ALLOC_IO,        /**< temporary buffers of loading and saving */
+  ALLOC_JOURNAL,   /**< move journals */
+  ALLOC_PACK,      /**< packs */
+  NB_ALLOC_SUBSYSTEMS
+} alloc_subsystem;
+
+/**
+ * @brief Custom allocation hooks.
+ **/
+typedef struct {
+  void* (*alloc)(size_t size, void* data);          /**< allocates size bytes, or returns NULL */
+  void (*free)(void* ptr, size_t size, void* data); /**< releases a block of size bytes */
+  void* data;                                       /**< passed to both hooks */
+} game_allocator;
+
+/**
+ * @brief Allocation counters of a subsystem.
+ **/
+typedef struct {
+  uint64_t nb_allocs; /**< number of allocations since the last reset */
+  uint64_t nb_frees;  /**< number of releases since the last reset */
+  size_t live_bytes;  /**< number of bytes currently allocated */
+} game_alloc_stats;
+
+/**
+ * @brief Installs the allocator of the library.
+ * @details The blocks are aligned on 16 bytes if the hook returns blocks
+ * aligned on 16 bytes. The hooks may be called from several threads at once,
+ * when the library is used by several threads.
+ * @param allocator the hooks (copied), or NULL to go back to malloc/free
+ * @pre No block of the library is allocated: this function must be called
+ * before creating any game, or once every game is deleted.
+ **/
+void game_set_allocator(const game_allocator* allocator);
+
+/**
+ * @brief Reads the allocation counters of a subsystem.
+ * @param subsystem the subsystem
+ * @param stats filled with the counters
+ **/
+void game_get_alloc_stats(alloc_subsystem subsystem, game_alloc_stats* stats);
+
+/**
+ * @brief Resets the allocation and release counts of every subsystem.
+ * @details The live bytes are kept, since the blocks are still allocated.
+ **/
+void game_reset_alloc_stats(void);
+
+#endif  // __GAME_ALLOC_H__
@@ -9,6 +9,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "game.h"
 #include "game_ext.h"
@@ -212,79 +213,67 @@ bool game_is_well_paired(cgame g) {
 
 /* ************************************************************************** */
 
-/* square colors used in BFS algorithm */
-typedef enum {
-  WHITE, /* square not yet visited  */
-  GRAY,  /* square partially visited */
-  BLACK, /* square fully visited (included all its neighbors) */
-} bfscolor;
-
 bool game_is_connected(cgame g) {
+  assert(g);
+  uint size = g->nb_rows * g->nb_cols;
+
+  /* the visited array and the BFS queue are on the heap, since large grids
+   * would not fit on the stack */
+  bool* visited = _game_malloc(ALLOC_CHECK, size * sizeof(bool));
+  uint* fifo = _game_malloc(ALLOC_CHECK, size * sizeof(uint));
+  assert(visited && fifo);
+  bool connected = game_is_connected_ext(g, visited, fifo);
+  _game_free(fifo);
+  _game_free(visited);
+  return connected;
+}
+
+/* ************************************************************************** */
+
+bool game_is_connected_ext(cgame g, bool* visited, uint* fifo) {
   /* In this algorithm, we assume all pieces are well paired (no edge mismatch).
    */
 
-  assert(g);
+  assert(g && visited && fifo);
   uint nb_cols = g->nb_cols;
   uint nb_rows = g->nb_rows;
+  uint size = nb_rows * nb_cols;
 
   // check precondition, but it should be already checked by the caller!
   if (!game_is_well_paired(g)) return false;
-
-  /* initialize visited array */
-  bfscolor visited[nb_rows][nb_cols];
-  for (uint i = 0; i < nb_rows; i++)
-    for (uint j = 0; j < nb_cols; j++) {
-      shape s = game_get_piece_shape(g, i, j);
-      visited[i][j] = WHITE;
-      if (s == EMPTY) visited[i][j] = BLACK;
-    }
-
-  /* lookup for a first square to start BFS */
-  bool start_found = false;
-  for (uint i = 0; i < nb_rows; i++)
-    for (uint j = 0; j < nb_cols; j++) {
-      if (visited[i][j] == WHITE && !start_found) {
-        visited[i][j] = GRAY;
-        start_found = true;
-      }
+  memset(visited, 0, size * sizeof(bool));
+
+  /* lookup for a first square to start BFS, and count the pieces */
+  uint start = size, nb_pieces = 0;
+  for (uint k = 0; k < size; k++)
+    if (g->squares[k].s != EMPTY) {
+      if (start == size) start = k;
+      nb_pieces++;
     }
 
-  /* BFS Algorithm */
-  bool new_visited = false;
-  do {
-    new_visited = false;
-    for (uint i = 0; i < nb_rows; i++)
-      for (uint j = 0; j < nb_cols; j++)
-        /* if the square (i,j) has been already visited, then we mark all its
-         * connected neighbors as visited...  */
-        if (visited[i][j] == GRAY) {
-          for (direction d = 0; d < NB_DIRS; d++) {
-            if (!game_has_half_edge(g, i, j, d)) continue;
-            uint nexti, nextj;
-            bool next = game_get_ajacent_square(g, i, j, d, &nexti, &nextj);
-            assert(next); /* Always true if the game is well paired! */
-            edge_status es = game_check_edge(g, i, j, d);
-            assert(es == MATCH); /* Always true... */
-
-            if (visited[nexti][nextj] == WHITE) {
-              visited[nexti][nextj] = GRAY;
-              new_visited = true;
-            }
-          }
-          /* now, we will not come back to this square... */
-          visited[i][j] = BLACK;
-        }
-  } while (new_visited == true);
-
-  // check all squares have been visited
-  for (uint i = 0; i < nb_rows; i++)
-    for (uint j = 0; j < nb_cols; j++) {
-      if (visited[i][j] != BLACK) {
-        return false;
+  /* BFS Algorithm, each square being queued once */
+  uint head = 0, tail = 0;
+  if (start < size) {
+    visited[start] = true;
+    fifo[tail++] = start;
+  }
+  while (head < tail) {
+    uint i = fifo[head] / nb_cols, j = fifo[head] % nb_cols;
+    head++;
+    for (direction d = 0; d < NB_DIRS; d++) {
+      if (!game_has_half_edge(g, i, j, d)) continue;
+      uint nexti, nextj;
+      bool next = game_get_ajacent_square(g, i, j, d, &nexti, &nextj);
+      assert(next); /* Always true if the game is well paired! */
+      uint k = nexti * nb_cols + nextj;
+      if (!visited[k]) {
+        visited[k] = true;
+        fifo[tail++] = k;
       }
     }
-
-  return true;
+  }
+  // check all pieces have been visited
+  return tail == nb_pieces;
 }
 
 /* ************************************************************************** */
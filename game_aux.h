@@ -107,4 +107,17 @@ bool game_is_well_paired(cgame g);
  */
 bool game_is_connected(cgame g);
 
+/**
+ * @brief Checks if the game is connected, using buffers owned by the caller.
+ * @details Same as @ref game_is_connected, without any allocation, so that a
+ * game can be checked repeatedly at no cost. The buffers are overwritten.
+ * @param g the game
+ * @param visited an array of nb_rows * nb_cols booleans
+ * @param fifo an array of nb_rows * nb_cols integers
+ * @pre @p g must be a valid pointer toward a game structure.
+ * @pre The game @p g is assumed to be well paired.
+ * @return true if the game is connected, false otherwise
+ */
+bool game_is_connected_ext(cgame g, bool* visited, uint* fifo);
+
 #endif  // __GAME_AUX_H__
@@ -7,6 +7,7 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -40,18 +41,17 @@ game game_new_ext(uint nb_rows, uint nb_cols, shape* shapes, direction* directio
 /* ************************************************************************** */
 
 game game_new_empty_ext(uint nb_rows, uint nb_cols, bool wrapping) {
-  game g = (game)malloc(sizeof(struct game_s));
+  game g = (game)_game_malloc(ALLOC_GAME, sizeof(struct game_s));
   assert(g);
   g->nb_rows = nb_rows;
   g->nb_cols = nb_cols;
   g->wrapping = wrapping;
-  g->squares = (square*)calloc(g->nb_rows * g->nb_cols, sizeof(square));
+  // calloc sets every square to EMPTY (0) in the NORTH (0) orientation
+  g->squares = (square*)_game_calloc(ALLOC_GAME, g->nb_rows * g->nb_cols, sizeof(square));
   assert(g->squares);
-  for (uint i = 0; i < g->nb_rows; i++)
-    for (uint j = 0; j < g->nb_cols; j++) {
-      SHAPE(g, i, j) = EMPTY;
-      ORIENTATION(g, i, j) = NORTH;
-    }
+  g->map = NULL;
+  g->map_size = 0;
+  g->journal = NULL;
 
   // initialize history
   g->undo_stack = queue_new();
@@ -79,9 +79,9 @@ bool game_is_wrapping(cgame g) { return g->wrapping; }
 void game_undo(game g) {
   assert(g);
   if (_stack_is_empty(g->undo_stack)) return;
-  move m = _stack_pop_move(g->undo_stack);
+  move m = _stack_transfer_move(g->undo_stack, g->redo_stack);
   game_set_piece_orientation(g, m.i, m.j, m.old);
-  _stack_push_move(g->redo_stack, m);
+  _journal_undo(g);
 }
 
 /* ************************************************************************** */
@@ -89,9 +89,30 @@ void game_undo(game g) {
 void game_redo(game g) {
   assert(g);
   if (_stack_is_empty(g->redo_stack)) return;
-  move m = _stack_pop_move(g->redo_stack);
+  move m = _stack_transfer_move(g->redo_stack, g->undo_stack);
   game_set_piece_orientation(g, m.i, m.j, m.new);
-  _stack_push_move(g->undo_stack, m);
+  _journal_redo(g);
+}
+
+/* ************************************************************************** */
+
+void game_shuffle_orientation_ext(game g, prng* rng) {
+  assert(g);
+  assert(rng);
+
+  // each 64-bit random number gives the orientations of 32 squares
+  uint size = g->nb_rows * g->nb_cols;
+  uint64_t bits = 0;
+  for (uint k = 0; k < size; k++) {
+    if (k % 32 == 0) bits = prng_next(rng);
+    g->squares[k].o = bits & 0b11;
+    bits >>= 2;
+  }
+
+  // reset history
+  _stack_clear(g->undo_stack);
+  _stack_clear(g->redo_stack);
+  _journal_orientations(g, true);
 }
 
 /* ************************************************************************** */
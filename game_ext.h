@@ -11,6 +11,7 @@
 #include <stdbool.h>
 
 #include "game.h"
+#include "prng.h"
 
 /**
  * @name Extended Functions
@@ -92,6 +93,17 @@ void game_undo(game g);
  **/
 void game_redo(game g);
 
+/**
+ * @brief Shuffles all the piece orientations, using a given random generator.
+ * @details Same as @ref game_shuffle_orientation, but all the random numbers
+ * are drawn from @p rng.
+ * @param g the game
+ * @param rng the random generator
+ * @pre @p g is a valid pointer toward a cgame structure
+ * @pre @p rng must be an initialized generator.
+ **/
+void game_shuffle_orientation_ext(game g, prng* rng);
+
 /**
  * @}
  */
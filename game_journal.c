@@ -0,0 +1,422 @@
+/**
+ * @file game_journal.c
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "game_journal.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "game_private.h"
+#include "game_struct.h"
+#include "queue.h"
+
+/* A journal starts with a header of JOURNAL_HEADER_SIZE bytes, the integers
+ * being stored in little-endian order:
+ *   0: magic "NETJ"
+ *   4: version (16 bits)
+ *   6: flags (16 bits, 0 for now)
+ *   8: size of the game record (32 bits)
+ * Then comes the game in the binary format (see game_save_binary), the number
+ * of moves in the undo and redo stacks, and these moves, from the bottom of
+ * each stack: the index of the square and the byte (old << 2) | new.
+ *
+ * Then each record is a variable-length integer x (7 bits per byte, the
+ * lowest bits first, the high bit set on every byte but the last one):
+ * - if x is even, this is a move: ((x >> 1) & 3) is the new orientation, and
+ *   (x >> 3) the zigzag-encoded difference between the index of the square
+ *   and the one of the previous move (0 for the first move);
+ * - otherwise, (x >> 1) is one of the events below. An ORIENTATIONS record is
+ *   followed by the orientations of all the squares, 4 per byte. */
+
+#define JOURNAL_MAGIC "NETJ"
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 12
+#define JOURNAL_BUFFER_SIZE 4096
+#define JOURNAL_BATCH 64 /* records written at once */
+
+typedef enum {
+  JOURNAL_UNDO = 0,     /* game_undo */
+  JOURNAL_REDO,         /* game_redo */
+  JOURNAL_RESET,        /* game_reset_orientation */
+  JOURNAL_CLEAR,        /* both stacks are cleared */
+  JOURNAL_ORIENTATIONS, /* every orientation is set, the stacks are kept */
+  NB_JOURNAL_EVENTS
+} journal_event;
+
+struct journal_s {
+  int fd;
+  unsigned char buf[JOURNAL_BUFFER_SIZE];
+  uint size;       /* bytes in the buffer */
+  uint nb_pending; /* records in the buffer */
+  uint last;       /* index of the square of the previous move */
+  bool ok;         /* false after a write error */
+};
+
+/* ************************************************************************** */
+
+static uint64_t _get(const unsigned char* p, uint nb_bytes) {
+  uint64_t v = 0;
+  for (uint b = 0; b < nb_bytes; b++) v |= (uint64_t)p[b] << (8 * b);
+  return v;
+}
+
+static void _put(unsigned char* p, uint64_t v, uint nb_bytes) {
+  for (uint b = 0; b < nb_bytes; b++) p[b] = v >> (8 * b);
+}
+
+/** encode x at p, return the number of bytes (at most 10) */
+static uint _put_varint(unsigned char* p, uint64_t x) {
+  uint n = 0;
+  while (x >= 0x80) {
+    p[n++] = (x & 0x7F) | 0x80;
+    x >>= 7;
+  }
+  p[n++] = x;
+  return n;
+}
+
+/** decode a number at *p, return false if it does not end before end */
+static bool _get_varint(const unsigned char** p, const unsigned char* end, uint64_t* x) {
+  *x = 0;
+  for (uint shift = 0; *p < end && shift < 64; shift += 7) {
+    unsigned char byte = *(*p)++;
+    *x |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+/** the moves of a stack, from the bottom, leaving the stack unchanged */
+static move* _stack_moves(queue* q, uint* nb_moves) {
+  uint n = queue_length(q);
+  move* moves = _game_malloc(ALLOC_JOURNAL, (n ? n : 1) * sizeof(move));
+  assert(moves);
+  for (uint k = n; k > 0; k--) moves[k - 1] = _stack_pop_move(q);
+  for (uint k = 0; k < n; k++) _stack_push_move(q, moves[k]);
+  *nb_moves = n;
+  return moves;
+}
+
+/* ************************************************************************** */
+/*                                  WRITING                                   */
+/* ************************************************************************** */
+
+static bool _write_all(int fd, const unsigned char* p, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static void _flush(journal* j) {
+  if (j->ok && j->size > 0) j->ok = _write_all(j->fd, j->buf, j->size);
+  j->size = 0;
+  j->nb_pending = 0;
+}
+
+/** make room for size bytes in the buffer */
+static unsigned char* _reserve(journal* j, uint size) {
+  if (j->size + size > JOURNAL_BUFFER_SIZE) _flush(j);
+  return j->buf + j->size;
+}
+
+static void _end_record(journal* j) {
+  if (++j->nb_pending == JOURNAL_BATCH) _flush(j);
+}
+
+void _journal_move(game g, uint i, uint j, direction new) {
+  journal* jn = g->journal;
+  if (jn == NULL) return;
+  uint k = INDEX(g, i, j);
+  int64_t delta = (int64_t)k - jn->last;
+  uint64_t zigzag = delta < 0 ? ((uint64_t)(-delta) << 1) - 1 : (uint64_t)delta << 1;
+  unsigned char* p = _reserve(jn, 10);
+  jn->size += _put_varint(p, zigzag << 3 | (uint64_t)new << 1);
+  jn->last = k;
+  _end_record(jn);
+}
+
+static void _journal_event(game g, journal_event e) {
+  journal* jn = g->journal;
+  if (jn == NULL) return;
+  *_reserve(jn, 1) = e << 1 | 1;
+  jn->size++;
+  if (e == JOURNAL_ORIENTATIONS) {
+    uint n = g->nb_rows * g->nb_cols;
+    for (uint k = 0; k < n; k += 4) {
+      unsigned char byte = 0;
+      for (uint b = 0; b < 4 && k + b < n; b++) byte |= g->squares[k + b].o << (2 * b);
+      *_reserve(jn, 1) = byte;
+      jn->size++;
+    }
+  }
+  _end_record(jn);
+}
+
+void _journal_undo(game g) { _journal_event(g, JOURNAL_UNDO); }
+
+void _journal_redo(game g) { _journal_event(g, JOURNAL_REDO); }
+
+void _journal_reset(game g) { _journal_event(g, JOURNAL_RESET); }
+
+void _journal_orientations(game g, bool clear) {
+  _journal_event(g, JOURNAL_ORIENTATIONS);
+  if (clear) _journal_event(g, JOURNAL_CLEAR);
+}
+
+/** attach a journal writing to fd, after the records already in the file */
+static void _attach(game g, int fd, uint last) {
+  journal* jn = _game_malloc(ALLOC_JOURNAL, sizeof(journal));
+  assert(jn);
+  jn->fd = fd;
+  jn->size = 0;
+  jn->nb_pending = 0;
+  jn->last = last;
+  jn->ok = true;
+  g->journal = jn;
+}
+
+static void _write_stack(unsigned char* buf, size_t* size, cgame g, const move* moves, uint nb_moves) {
+  for (uint k = 0; k < nb_moves; k++) {
+    *size += _put_varint(buf + *size, INDEX(g, moves[k].i, moves[k].j));
+    buf[(*size)++] = moves[k].old << 2 | moves[k].new;
+  }
+}
+
+bool game_journal_start(game g, char* filename) {
+  assert(g && filename);
+  game_journal_stop(g);
+  size_t game_size;
+  char* record = game_save_binary_to_buffer(g, &game_size);
+  if (record == NULL) return false;
+  uint nb_undo, nb_redo;
+  move* undo = _stack_moves(g->undo_stack, &nb_undo);
+  move* redo = _stack_moves(g->redo_stack, &nb_redo);
+  // each move takes at most 5 + 1 bytes, each count at most 5
+  size_t max_size = JOURNAL_HEADER_SIZE + game_size + 10 + 6 * ((size_t)nb_undo + nb_redo);
+  unsigned char* buf = _game_malloc(ALLOC_JOURNAL, max_size);
+  assert(buf);
+  memcpy(buf, JOURNAL_MAGIC, 4);
+  _put(buf + 4, JOURNAL_VERSION, 2);
+  _put(buf + 6, 0, 2);
+  _put(buf + 8, game_size, 4);
+  memcpy(buf + JOURNAL_HEADER_SIZE, record, game_size);
+  size_t size = JOURNAL_HEADER_SIZE + game_size;
+  size += _put_varint(buf + size, nb_undo);
+  size += _put_varint(buf + size, nb_redo);
+  _write_stack(buf, &size, g, undo, nb_undo);
+  _write_stack(buf, &size, g, redo, nb_redo);
+
+  /* the snapshot is written to a temporary file, renamed over the journal
+   * once on disk, so that a failure leaves the previous journal unchanged;
+   * the records are then appended to the renamed file */
+  size_t len = strlen(filename) + 32;
+  char* tmp = _game_malloc(ALLOC_JOURNAL, len);
+  assert(tmp);
+  snprintf(tmp, len, "%s.XXXXXX", filename);
+  int fd = mkstemp(tmp);
+  bool ok = fd >= 0 && fchmod(fd, 0644) == 0 && _write_all(fd, buf, size) && fsync(fd) == 0 &&
+            rename(tmp, filename) == 0;
+  if (ok) {
+    _attach(g, fd, 0);
+  } else if (fd >= 0) {
+    close(fd);
+    unlink(tmp);
+  }
+  _game_free(tmp);
+  _game_free(buf);
+  _game_free(redo);
+  _game_free(undo);
+  free(record);
+  return ok;
+}
+
+bool game_journal_flush(game g) {
+  assert(g);
+  if (g->journal == NULL) return true;
+  _flush(g->journal);
+  return g->journal->ok;
+}
+
+bool game_journal_stop(game g) {
+  assert(g);
+  journal* jn = g->journal;
+  if (jn == NULL) return true;
+  _flush(jn);
+  bool ok = jn->ok;
+  ok = (close(jn->fd) == 0) && ok;
+  _game_free(jn);
+  g->journal = NULL;
+  return ok;
+}
+
+/* ************************************************************************** */
+/*                                  RESTORE                                   */
+/* ************************************************************************** */
+
+static game _journal_error(load_error* err, load_status status, size_t offset, game g) {
+  if (err) *err = (load_error){status, 0, offset + 1};
+  if (g) game_delete(g);
+  return NULL;
+}
+
+/** read the moves of a stack from the snapshot */
+static bool _read_stack(const unsigned char** p, const unsigned char* end, game g, queue* q, uint nb_moves) {
+  uint n = g->nb_rows * g->nb_cols;
+  for (uint k = 0; k < nb_moves; k++) {
+    uint64_t index;
+    if (!_get_varint(p, end, &index) || index >= n || *p == end) return false;
+    unsigned char byte = *(*p)++;
+    if (byte >> 4) return false;
+    move m = {index / g->nb_cols, index % g->nb_cols, byte >> 2, byte & 3};
+    _stack_push_move(q, m);
+  }
+  return true;
+}
+
+/** replay a record on g, return false if it is invalid; *p is moved past
+ * the record, unless it is incomplete */
+static bool _replay(const unsigned char** p, const unsigned char* end, game g, uint* last, bool* complete) {
+  const unsigned char* q = *p;
+  uint64_t x;
+  *complete = _get_varint(&q, end, &x);
+  if (!*complete) return true;
+  uint n = g->nb_rows * g->nb_cols;
+  if (!(x & 1)) {
+    uint64_t zigzag = x >> 3;
+    int64_t delta = (zigzag & 1) ? -(int64_t)((zigzag + 1) >> 1) : (int64_t)(zigzag >> 1);
+    int64_t k = (int64_t)*last + delta;
+    if (k < 0 || k >= n) return false;
+    move m = {k / g->nb_cols, k % g->nb_cols, g->squares[k].o, (x >> 1) & 3};
+    g->squares[k].o = m.new;
+    _stack_clear(g->redo_stack);
+    _stack_push_move(g->undo_stack, m);
+    *last = k;
+  } else {
+    switch (x >> 1) {
+      case JOURNAL_UNDO:
+        game_undo(g);
+        break;
+      case JOURNAL_REDO:
+        game_redo(g);
+        break;
+      case JOURNAL_RESET:
+        game_reset_orientation(g);
+        break;
+      case JOURNAL_CLEAR:
+        _stack_clear(g->undo_stack);
+        _stack_clear(g->redo_stack);
+        break;
+      case JOURNAL_ORIENTATIONS:
+        if ((size_t)(end - q) < (n + 3) / 4) {
+          *complete = false;
+          return true;
+        }
+        for (uint k = 0; k < n; k++) g->squares[k].o = (q[k / 4] >> (2 * (k % 4))) & 3;
+        q += (n + 3) / 4;
+        break;
+      default:
+        return false;
+    }
+  }
+  *p = q;
+  return true;
+}
+
+/** restore the journal, and give the end of its last complete record */
+static game _journal_read(char* filename, load_error* err, size_t* end_offset, uint* last) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) return _journal_error(err, LOAD_ERR_OPEN, 0, NULL);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return _journal_error(err, LOAD_ERR_OPEN, 0, NULL);
+  }
+  if (st.st_size < JOURNAL_HEADER_SIZE) {
+    close(fd);
+    return _journal_error(err, LOAD_ERR_HEADER, 0, NULL);
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return _journal_error(err, LOAD_ERR_OPEN, 0, NULL);
+  const unsigned char* buf = data;
+  const unsigned char* end = buf + st.st_size;
+  game g = NULL;
+  load_status status = LOAD_ERR_HEADER;
+  const unsigned char* p = buf;
+
+  uint64_t game_size = _get(buf + 8, 4), nb_undo, nb_redo;
+  if (memcmp(buf, JOURNAL_MAGIC, 4) != 0 || _get(buf + 6, 2) != 0 ||
+      game_size > (uint64_t)st.st_size - JOURNAL_HEADER_SIZE)
+    goto error;
+  p = buf + 4;
+  status = LOAD_ERR_VERSION;
+  if (_get(buf + 4, 2) != JOURNAL_VERSION) goto error;
+  p = buf + JOURNAL_HEADER_SIZE;
+  load_error game_err;
+  g = game_load_from_buffer((const char*)p, game_size, &game_err);
+  if (g == NULL) {
+    status = game_err.status;
+    p += game_err.col ? game_err.col - 1 : 0;
+    goto error;
+  }
+  p += game_size;
+  status = LOAD_ERR_TRUNCATED;
+  if (!_get_varint(&p, end, &nb_undo) || !_get_varint(&p, end, &nb_redo) || nb_undo > UINT32_MAX ||
+      nb_redo > UINT32_MAX)
+    goto error;
+  status = LOAD_ERR_RECORD;
+  if (!_read_stack(&p, end, g, g->undo_stack, nb_undo) || !_read_stack(&p, end, g, g->redo_stack, nb_redo)) goto error;
+
+  *last = 0;
+  bool complete = true;
+  while (p < end && complete)
+    if (!_replay(&p, end, g, last, &complete)) goto error;
+  *end_offset = p - buf;
+  munmap(data, st.st_size);
+  if (err) *err = (load_error){LOAD_OK, 0, 0};
+  return g;
+
+error:
+  _journal_error(err, status, p - buf, g);
+  munmap(data, st.st_size);
+  return NULL;
+}
+
+game game_journal_load(char* filename, load_error* err) {
+  assert(filename);
+  size_t end;
+  uint last;
+  return _journal_read(filename, err, &end, &last);
+}
+
+game game_journal_open(char* filename, load_error* err) {
+  assert(filename);
+  size_t end;
+  uint last;
+  game g = _journal_read(filename, err, &end, &last);
+  if (g == NULL) return NULL;
+  // drop a record cut short, then append
+  int fd = open(filename, O_WRONLY);
+  if (fd < 0 || ftruncate(fd, end) != 0 || lseek(fd, end, SEEK_SET) < 0) {
+    if (fd >= 0) close(fd);
+    game_delete(g);
+    return _journal_error(err, LOAD_ERR_OPEN, 0, NULL);
+  }
+  _attach(g, fd, last);
+  return g;
+}
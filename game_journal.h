@@ -0,0 +1,81 @@
+/**
+ * @file game_journal.h
+ * @brief Move journals, keeping the whole history of a game on disk.
+ * @details A journal starts with a snapshot of the game, including its undo
+ * and redo stacks, followed by one small record per action (move, undo, redo,
+ * reset, shuffle...), appended as the actions are played. Restoring a journal
+ * replays its records, so the game comes back with both stacks, and the
+ * journal also serves as a replay of the session.
+ *
+ * The records are delta-encoded: a move stores the distance to the square of
+ * the previous move and the new orientation, as a variable-length integer, so
+ * that most moves take one or two bytes. They are buffered and written by
+ * batches; a record cut short by a crash is ignored when restoring.
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#ifndef __GAME_JOURNAL_H__
+#define __GAME_JOURNAL_H__
+
+#include <stdbool.h>
+
+#include "game.h"
+#include "game_tools.h"
+
+/**
+ * @brief Starts a new journal for a game.
+ * @details The file is replaced with a snapshot of the game, written to a
+ * temporary file first, so that a failure leaves the previous file unchanged.
+ * Every later action on the game is recorded, until the journal is
+ * stopped or the game deleted. The actions that are recorded are the moves
+ * (@ref game_play_move), @ref game_undo, @ref game_redo, @ref
+ * game_reset_orientation, the shuffles and @ref game_solve. The direct
+ * changes of a square (@ref game_set_piece_orientation, @ref
+ * game_set_piece_shape) are not recorded. A game has at most one journal: the
+ * previous one is stopped.
+ * @param g the game
+ * @param filename the journal file
+ * @return true if the journal is created, false otherwise
+ **/
+bool game_journal_start(game g, char* filename);
+
+/**
+ * @brief Restores a game from its journal, and goes on recording in it.
+ * @details Same as @ref game_journal_load, then the next actions are appended
+ * to the journal, after the last complete record.
+ * @param filename the journal file
+ * @param err if not NULL, filled with the status of the loading
+ * @return the restored game, or NULL if the journal cannot be loaded
+ **/
+game game_journal_open(char* filename, load_error* err);
+
+/**
+ * @brief Restores a game from its journal.
+ * @details The snapshot is loaded, then every record is replayed, so the game
+ * comes back with its undo and redo stacks. The game is not attached to the
+ * journal.
+ * @param filename the journal file
+ * @param err if not NULL, filled with the status of the loading (the column
+ * is the byte offset + 1 of the error)
+ * @return the restored game, or NULL if the journal cannot be loaded
+ **/
+game game_journal_load(char* filename, load_error* err);
+
+/**
+ * @brief Writes the buffered records of the journal of a game.
+ * @param g the game
+ * @return true if every record has been written so far (or if the game has no
+ * journal), false after a write error
+ **/
+bool game_journal_flush(game g);
+
+/**
+ * @brief Stops recording the actions of a game in its journal.
+ * @details The buffered records are written and the file is closed. This is
+ * done by @ref game_delete as well.
+ * @param g the game
+ * @return true if the whole journal is written, false otherwise
+ **/
+bool game_journal_stop(game g);
+
+#endif  // __GAME_JOURNAL_H__
@@ -0,0 +1,237 @@
+/**
+ * @file game_pack.c
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "game_pack.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "game_private.h"
+#include "game_tools.h"
+
+/* The header takes PACK_HEADER_SIZE bytes, all the integers being stored in
+ * little-endian order:
+ *   0: magic "NETP"
+ *   4: version (16 bits)
+ *   6: flags (16 bits, 0 for now)
+ *   8: number of games (32 bits)
+ *  12: reserved (32 bits)
+ *  16: offset of the index (64 bits)
+ *  24: reserved (64 bits)
+ * Each entry of the index takes PACK_ENTRY_SIZE bytes: the offset of the game
+ * record (64 bits), its size (32 bits) and the size of the solution record
+ * that follows it (32 bits, 0 if there is no solution). */
+
+#define PACK_MAGIC "NETP"
+#define PACK_VERSION 1
+#define PACK_HEADER_SIZE 32
+#define PACK_ENTRY_SIZE 16
+
+struct pack_s {
+  const unsigned char* data; /* the mapped file */
+  size_t size;
+  uint count;
+  const unsigned char* index;
+};
+
+struct pack_writer_s {
+  FILE* file;
+  char* filename;
+  char* tmp;
+  uint64_t offset;      /* offset of the next record */
+  unsigned char* index; /* index entries, written at the end */
+  uint count, capacity;
+  bool ok; /* false after a write error */
+};
+
+/* ************************************************************************** */
+
+static uint64_t _get(const unsigned char* p, uint nb_bytes) {
+  uint64_t v = 0;
+  for (uint b = 0; b < nb_bytes; b++) v |= (uint64_t)p[b] << (8 * b);
+  return v;
+}
+
+static void _put(unsigned char* p, uint64_t v, uint nb_bytes) {
+  for (uint b = 0; b < nb_bytes; b++) p[b] = v >> (8 * b);
+}
+
+/* ************************************************************************** */
+/*                                  READER                                    */
+/* ************************************************************************** */
+
+bool pack_is_pack(char* filename) {
+  FILE* f = fopen(filename, "rb");
+  if (f == NULL) return false;
+  char magic[4];
+  bool ok = fread(magic, 1, 4, f) == 4 && memcmp(magic, PACK_MAGIC, 4) == 0;
+  fclose(f);
+  return ok;
+}
+
+pack pack_open(char* filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < PACK_HEADER_SIZE) {
+    close(fd);
+    return NULL;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+
+  const unsigned char* d = data;
+  size_t size = st.st_size;
+  uint count = _get(d + 8, 4);
+  uint64_t index = _get(d + 16, 8);
+  if (memcmp(d, PACK_MAGIC, 4) != 0 || _get(d + 4, 2) != PACK_VERSION || index < PACK_HEADER_SIZE || index > size ||
+      (size - index) / PACK_ENTRY_SIZE < count) {
+    munmap(data, size);
+    return NULL;
+  }
+  pack p = _game_malloc(ALLOC_PACK, sizeof(struct pack_s));
+  assert(p);
+  p->data = d;
+  p->size = size;
+  p->count = count;
+  p->index = d + index;
+  return p;
+}
+
+void pack_close(pack p) {
+  if (p == NULL) return;
+  munmap((void*)p->data, p->size);
+  _game_free(p);
+}
+
+uint pack_count(pack p) {
+  assert(p);
+  return p->count;
+}
+
+/** load the record at offset, if it lies inside the file */
+static game _load_record(pack p, uint64_t offset, uint64_t size) {
+  if (size == 0 || offset > p->size || size > p->size - offset) return NULL;
+  return game_load_from_buffer((const char*)p->data + offset, size, NULL);
+}
+
+game pack_get(pack p, uint k) {
+  assert(p && k < p->count);
+  const unsigned char* e = p->index + (size_t)k * PACK_ENTRY_SIZE;
+  return _load_record(p, _get(e, 8), _get(e + 8, 4));
+}
+
+game pack_get_solution(pack p, uint k) {
+  assert(p && k < p->count);
+  const unsigned char* e = p->index + (size_t)k * PACK_ENTRY_SIZE;
+  return _load_record(p, _get(e, 8) + _get(e + 8, 4), _get(e + 12, 4));
+}
+
+/* ************************************************************************** */
+/*                                  WRITER                                    */
+/* ************************************************************************** */
+
+pack_writer pack_writer_open(char* filename) {
+  pack_writer w = _game_calloc(ALLOC_PACK, 1, sizeof(struct pack_writer_s));
+  assert(w);
+  size_t len = strlen(filename) + 32;
+  w->filename = _game_malloc(ALLOC_PACK, strlen(filename) + 1);
+  w->tmp = _game_malloc(ALLOC_PACK, len);
+  assert(w->filename && w->tmp);
+  strcpy(w->filename, filename);
+  // unique temporary file, so that several writers may write the same pack
+  snprintf(w->tmp, len, "%s.XXXXXX", filename);
+  int fd = mkstemp(w->tmp);
+  w->file = (fd >= 0 && fchmod(fd, 0644) == 0) ? fdopen(fd, "wb") : NULL;
+  if (w->file == NULL) {
+    if (fd >= 0) {
+      close(fd);
+      unlink(w->tmp);
+    }
+    _game_free(w->filename);
+    _game_free(w->tmp);
+    _game_free(w);
+    return NULL;
+  }
+  // the header is written again when closing, once the index is known
+  unsigned char header[PACK_HEADER_SIZE] = {0};
+  w->ok = fwrite(header, 1, PACK_HEADER_SIZE, w->file) == PACK_HEADER_SIZE;
+  w->offset = PACK_HEADER_SIZE;
+  return w;
+}
+
+/** write a game record, return its size (0 on error) */
+static size_t _write_record(pack_writer w, cgame g) {
+  size_t size;
+  char* buf = game_save_binary_to_buffer(g, &size);
+  if (buf == NULL) return 0;
+  if (size > UINT32_MAX || fwrite(buf, 1, size, w->file) != size) size = 0;
+  free(buf);
+  return size;
+}
+
+bool pack_writer_add(pack_writer w, cgame g, cgame solution) {
+  assert(w && g);
+  if (!w->ok || w->count == UINT32_MAX) return false;
+  if (w->count == w->capacity) {
+    w->capacity = w->capacity ? 2 * w->capacity : 1024;
+    w->index = _game_realloc(ALLOC_PACK, w->index, (size_t)w->capacity * PACK_ENTRY_SIZE);
+    assert(w->index);
+  }
+  size_t size = _write_record(w, g);
+  size_t sol_size = (size && solution) ? _write_record(w, solution) : 0;
+  if (size == 0 || (solution && sol_size == 0)) {
+    w->ok = false;
+    return false;
+  }
+  unsigned char* e = w->index + (size_t)w->count * PACK_ENTRY_SIZE;
+  _put(e, w->offset, 8);
+  _put(e + 8, size, 4);
+  _put(e + 12, sol_size, 4);
+  w->offset += size + sol_size;
+  w->count++;
+  return true;
+}
+
+bool pack_writer_close(pack_writer w) {
+  assert(w);
+  unsigned char header[PACK_HEADER_SIZE] = {0};
+  memcpy(header, PACK_MAGIC, 4);
+  _put(header + 4, PACK_VERSION, 2);
+  _put(header + 8, w->count, 4);
+  _put(header + 16, w->offset, 8);
+  size_t index_size = (size_t)w->count * PACK_ENTRY_SIZE;
+  bool ok = w->ok && fwrite(w->index, 1, index_size, w->file) == index_size && fseek(w->file, 0, SEEK_SET) == 0 &&
+            fwrite(header, 1, PACK_HEADER_SIZE, w->file) == PACK_HEADER_SIZE && fflush(w->file) == 0 &&
+            fsync(fileno(w->file)) == 0;
+  ok = (fclose(w->file) == 0) && ok;
+  ok = ok && rename(w->tmp, w->filename) == 0;
+  if (!ok) unlink(w->tmp);
+  _game_free(w->index);
+  _game_free(w->filename);
+  _game_free(w->tmp);
+  _game_free(w);
+  return ok;
+}
+
+void pack_writer_abort(pack_writer w) {
+  assert(w);
+  fclose(w->file);
+  unlink(w->tmp);
+  _game_free(w->index);
+  _game_free(w->filename);
+  _game_free(w->tmp);
+  _game_free(w);
+}
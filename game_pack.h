@@ -0,0 +1,109 @@
+/**
+ * @file game_pack.h
+ * @brief Pack files, holding many games with random access.
+ * @details A pack starts with a 32-byte header, followed by the game records
+ * in the binary format (see @ref game_save_binary), each one optionally
+ * followed by its solution, and ends with an index giving the position of
+ * every record. A pack is written in a single pass, and read by mapping the
+ * file in memory, so that any game can be loaded without parsing the others.
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#ifndef __GAME_PACK_H__
+#define __GAME_PACK_H__
+
+#include <stdbool.h>
+
+#include "game.h"
+
+/**
+ * @brief An open pack, for reading.
+ **/
+typedef struct pack_s* pack;
+
+/**
+ * @brief A pack being written.
+ **/
+typedef struct pack_writer_s* pack_writer;
+
+/**
+ * @brief Opens a pack for reading.
+ * @param filename the pack file
+ * @return the pack, or NULL if the file cannot be read or is not a valid pack
+ **/
+pack pack_open(char* filename);
+
+/**
+ * @brief Checks whether a file is a pack, by reading its magic number.
+ * @param filename the file
+ * @return true if the file starts like a pack
+ **/
+bool pack_is_pack(char* filename);
+
+/**
+ * @brief Closes a pack, and releases its memory.
+ * @details The games loaded from the pack remain valid.
+ * @param p the pack
+ **/
+void pack_close(pack p);
+
+/**
+ * @brief Gets the number of games in a pack.
+ * @param p the pack
+ * @return the number of games
+ **/
+uint pack_count(pack p);
+
+/**
+ * @brief Loads a game of a pack.
+ * @param p the pack
+ * @param k the index of the game
+ * @pre @p k < pack_count(p)
+ * @return the game, or NULL if its record is corrupted
+ **/
+game pack_get(pack p, uint k);
+
+/**
+ * @brief Loads the solution of a game of a pack.
+ * @param p the pack
+ * @param k the index of the game
+ * @pre @p k < pack_count(p)
+ * @return the solution, or NULL if it is not stored in the pack (or corrupted)
+ **/
+game pack_get_solution(pack p, uint k);
+
+/**
+ * @brief Creates a new pack.
+ * @details The games are written as they are added. The pack is written to a
+ * temporary file, renamed when the writer is closed, so that a pack is never
+ * left incomplete.
+ * @param filename the pack file
+ * @return the writer, or NULL if the file cannot be created
+ **/
+pack_writer pack_writer_open(char* filename);
+
+/**
+ * @brief Adds a game to a pack.
+ * @param w the writer
+ * @param g the game
+ * @param solution the solution of @p g, or NULL
+ * @return true if the game is written, false otherwise
+ **/
+bool pack_writer_add(pack_writer w, cgame g, cgame solution);
+
+/**
+ * @brief Finishes a pack: writes its index and closes the file.
+ * @param w the writer, released by this function
+ * @return true if the whole pack is written, false otherwise (then the file is
+ * not created)
+ **/
+bool pack_writer_close(pack_writer w);
+
+/**
+ * @brief Gives up a pack: closes and removes its temporary file.
+ * @details The pack file, if it exists, is left unchanged.
+ * @param w the writer, released by this function
+ **/
+void pack_writer_abort(pack_writer w);
+
+#endif  // __GAME_PACK_H__
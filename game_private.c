@@ -21,7 +21,7 @@
 
 void _stack_push_move(queue* q, move m) {
   assert(q);
-  move* pm = malloc(sizeof(move));
+  move* pm = _game_malloc(ALLOC_HISTORY, sizeof(move));
   assert(pm);
   *pm = m;
   queue_push_head(q, pm);
@@ -34,7 +34,28 @@ move _stack_pop_move(queue* q) {
   move* pm = queue_pop_head(q);
   assert(pm);
   move m = *pm;
-  free(pm);
+  _game_free(pm);
+  return m;
+}
+
+/* ************************************************************************** */
+
+void _stack_push_move_from(queue* q, queue* spare, move m) {
+  assert(q && spare);
+  if (queue_is_empty(spare)) {
+    _stack_push_move(q, m);
+    return;
+  }
+  queue_move_head(spare, q);
+  *(move*)queue_peek_head(q) = m;
+}
+
+/* ************************************************************************** */
+
+move _stack_transfer_move(queue* from, queue* to) {
+  assert(from && to);
+  move m = *(move*)queue_peek_head(from);
+  queue_move_head(from, to);
   return m;
 }
 
@@ -49,7 +70,7 @@ bool _stack_is_empty(queue* q) {
 
 void _stack_clear(queue* q) {
   assert(q);
-  queue_clear_full(q, free);
+  queue_clear_full(q, _game_free);
   assert(queue_is_empty(q));
 }
 
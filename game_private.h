@@ -10,6 +10,7 @@
 #include <stdbool.h>
 
 #include "game.h"
+#include "game_alloc.h"
 #include "game_struct.h"
 #include "queue.h"
 
@@ -34,6 +35,26 @@ typedef struct move_s move;
 /* ************************************************************************** */
 
 #define MAX(x, y) ((x > (y)) ? (x) : (y))
+#define MIN(x, y) ((x < (y)) ? (x) : (y))
+
+/* ************************************************************************** */
+/*                            ALLOCATION ROUTINES                             */
+/* ************************************************************************** */
+
+/* These functions allocate through the allocator of the library (see
+ * game_alloc.h), and count the blocks of each subsystem. */
+
+/** allocate a block, or return NULL */
+void* _game_malloc(alloc_subsystem subsystem, size_t size);
+
+/** allocate a block filled with zeros, or return NULL */
+void* _game_calloc(alloc_subsystem subsystem, size_t nb, size_t size);
+
+/** resize a block (kept in its subsystem), or return NULL and keep it */
+void* _game_realloc(alloc_subsystem subsystem, void* ptr, size_t size);
+
+/** release a block (NULL is allowed) */
+void _game_free(void* ptr);
 
 /* ************************************************************************** */
 /*                             STACK ROUTINES                                 */
@@ -45,12 +66,41 @@ void _stack_push_move(queue* q, move m);
 /** pop a move from the stack */
 move _stack_pop_move(queue* q);
 
+/** push a move in the stack, reusing the top element of the spare stack if
+ * any, instead of allocating a new one */
+void _stack_push_move_from(queue* q, queue* spare, move m);
+
+/** move the top move of a stack to the top of another one, and return it */
+move _stack_transfer_move(queue* from, queue* to);
+
 /** test if the stack is empty */
 bool _stack_is_empty(queue* q);
 
 /** clear all the stack */
 void _stack_clear(queue* q);
 
+/* ************************************************************************** */
+/*                             JOURNAL ROUTINES                               */
+/* ************************************************************************** */
+
+/* These functions record an action in the journal of the game, if any. */
+
+/** record a move, once played */
+void _journal_move(game g, uint i, uint j, direction new);
+
+/** record an undo, once done */
+void _journal_undo(game g);
+
+/** record a redo, once done */
+void _journal_redo(game g);
+
+/** record a reset of the orientations */
+void _journal_reset(game g);
+
+/** record the current orientations of all the squares, and the clearing of
+ * the history if asked */
+void _journal_orientations(game g, bool clear);
+
 /* ************************************************************************** */
 /*                                MISC                                        */
 /* ************************************************************************** */
@@ -1,44 +1,332 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <float.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "game.h"
 #include "game_aux.h"
+#include "game_ext.h"
+#include "game_pack.h"
 #include "game_tools.h"
+#include "prng.h"
+
+#define NB_TRIES 10000
+
+/** generate a game, with a unique solution if asked, and within the difficulty
+ * band, or return NULL if no such game is found */
+static game _generate(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, bool unique,
+                      double min_difficulty, double max_difficulty, prng* rng) {
+  bool graded = min_difficulty > 0 || max_difficulty < DBL_MAX;
+  for (uint t = 0; t < NB_TRIES; t++) {
+    game g = unique ? game_random_unique(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, rng)
+                    : game_random_ext(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, rng);
+    if (g == NULL) break;
+    if (!graded) return g;
+    // the grade does not depend on the orientations, so filter before shuffling
+    game_stats stats;
+    game_grade(g, &stats);
+    if (stats.difficulty >= min_difficulty && stats.difficulty <= max_difficulty) return g;
+    game_delete(g);
+  }
+  return NULL;
+}
+
+/* ************************************************************************** */
+/*                                 BULK MODE                                  */
+/* ************************************************************************** */
+
+/* In bulk mode, the worker threads generate the games and push them through a
+ * bounded queue to the main thread, which is the only one writing the output
+ * file (a pack, or a plain sequence of games). The game k draws its random
+ * numbers from its own generator, the seeded one jumped k times, so the streams
+ * never overlap. The game k is stored in the slot k % capacity of the queue and
+ * the games are written in index order, so the output only depends on the
+ * seed, whatever the number of threads. */
+
+typedef struct {
+  uint nb_rows, nb_cols, nb_empty, nb_extra;
+  bool wrapping, shuffle, unique;
+  bool binary, pack; /* output format */
+  double min_difficulty, max_difficulty;
+  uint count;   /* number of games to generate */
+  uint claimed; /* number of games already assigned to a worker */
+  uint written; /* number of games already taken by the main thread */
+  prng stream;  /* generator of the next game to assign */
+  bool failed;  /* a game could not be generated */
+  bool stop;    /* the workers must stop */
+  game* items;  /* bounded queue of generated games and their solutions (ring buffer) */
+  bool* ready;  /* whether each slot holds its game */
+  uint capacity;
+  pthread_mutex_t lock;
+  pthread_cond_t not_full, not_empty;
+} bulk;
+
+/** reserve the next game to generate with its generator, or return false if
+ * all are reserved or the run is stopped */
+static bool _bulk_claim(bulk* b, uint* k, prng* rng) {
+  pthread_mutex_lock(&b->lock);
+  bool ok = !b->stop && b->claimed < b->count;
+  if (ok) {
+    *k = b->claimed++;
+    *rng = b->stream;
+    prng_jump(&b->stream);
+  }
+  pthread_mutex_unlock(&b->lock);
+  return ok;
+}
+
+/** stop the workers, and wake up every thread waiting on the queue */
+static void _bulk_stop(bulk* b, bool failed) {
+  pthread_mutex_lock(&b->lock);
+  b->stop = true;
+  b->failed = b->failed || failed;
+  pthread_cond_broadcast(&b->not_full);
+  pthread_cond_broadcast(&b->not_empty);
+  pthread_mutex_unlock(&b->lock);
+}
+
+/** store the game k in its slot, or record a failure if g is NULL */
+static void _bulk_push(bulk* b, uint k, game g, game solution) {
+  if (g == NULL) {
+    _bulk_stop(b, true);
+    return;
+  }
+  pthread_mutex_lock(&b->lock);
+  while (!b->stop && k >= b->written + b->capacity) pthread_cond_wait(&b->not_full, &b->lock);
+  bool stored = !b->stop;
+  if (stored) {
+    uint slot = k % b->capacity;
+    b->items[2 * slot] = g;
+    b->items[2 * slot + 1] = solution;
+    b->ready[slot] = true;
+    if (k == b->written) pthread_cond_signal(&b->not_empty);
+  }
+  pthread_mutex_unlock(&b->lock);
+  if (!stored) {
+    game_delete(g);
+    if (solution) game_delete(solution);
+  }
+}
+
+/** take the next game in index order, or return NULL if a game could not be
+ * generated */
+static game _bulk_pop(bulk* b, game* solution) {
+  pthread_mutex_lock(&b->lock);
+  uint slot = b->written % b->capacity;
+  while (!b->failed && !b->ready[slot]) pthread_cond_wait(&b->not_empty, &b->lock);
+  game g = NULL;
+  if (!b->failed) {
+    g = b->items[2 * slot];
+    *solution = b->items[2 * slot + 1];
+    b->ready[slot] = false;
+    b->written++;
+    pthread_cond_broadcast(&b->not_full);
+  }
+  pthread_mutex_unlock(&b->lock);
+  return g;
+}
+
+static void* _bulk_worker(void* arg) {
+  bulk* b = arg;
+  uint k;
+  prng rng;
+  while (_bulk_claim(b, &k, &rng)) {
+    game g = _generate(b->nb_rows, b->nb_cols, b->wrapping, b->nb_empty, b->nb_extra, b->unique, b->min_difficulty,
+                       b->max_difficulty, &rng);
+    game solution = NULL;
+    if (g) {
+      // packs store the solution of the shuffled games
+      if (b->pack && b->shuffle) solution = game_copy(g);
+      if (b->shuffle) game_shuffle_orientation_ext(g, &rng);
+    }
+    _bulk_push(b, k, g, solution);
+  }
+  return NULL;
+}
+
+static double _now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void _bulk_run(bulk* b, uint nb_threads, uint64_t seed, char* filename) {
+  pack_writer writer = b->pack ? pack_writer_open(filename) : NULL;
+  FILE* file = b->pack ? NULL : fopen(filename, "wb");
+  if (file == NULL && writer == NULL) {
+    fprintf(stderr, "Error: Cannot open %s.\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  b->capacity = 4 * nb_threads;
+  b->items = malloc(2 * b->capacity * sizeof(game));
+  b->ready = calloc(b->capacity, sizeof(bool));
+  pthread_t* threads = malloc(nb_threads * sizeof(pthread_t));
+  if (b->items == NULL || b->ready == NULL || threads == NULL) {
+    fprintf(stderr, "Error: Not enough memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  pthread_mutex_init(&b->lock, NULL);
+  pthread_cond_init(&b->not_full, NULL);
+  pthread_cond_init(&b->not_empty, NULL);
+
+  double start = _now();
+  prng_seed(&b->stream, seed);
+  uint nb_started = 0;
+  for (; nb_started < nb_threads; nb_started++)
+    if (pthread_create(&threads[nb_started], NULL, _bulk_worker, b) != 0) break;
+  bool ok = nb_started > 0;
+  if (!ok) fprintf(stderr, "Error: Cannot create thread.\n");
+  for (uint k = 0; ok && k < b->count; k++) {
+    game solution;
+    game g = _bulk_pop(b, &solution);
+    if (g == NULL) {
+      fprintf(stderr, "Error: Cannot generate a game with these constraints.\n");
+      ok = false;
+      break;
+    }
+    if (writer)
+      ok = pack_writer_add(writer, g, solution);
+    else
+      ok = b->binary ? game_save_binary_file(g, file) : game_save_file(g, file);
+    if (!ok) fprintf(stderr, "Error: Cannot write %s.\n", filename);
+    game_delete(g);
+    if (solution) game_delete(solution);
+  }
+  // on error, the workers are stopped before the output is removed
+  if (!ok) _bulk_stop(b, false);
+  for (uint t = 0; t < nb_started; t++) pthread_join(threads[t], NULL);
+  double elapsed = _now() - start;
+  for (uint slot = 0; slot < b->capacity; slot++)
+    if (b->ready[slot]) {
+      game_delete(b->items[2 * slot]);
+      if (b->items[2 * slot + 1]) game_delete(b->items[2 * slot + 1]);
+    }
+
+  pthread_cond_destroy(&b->not_empty);
+  pthread_cond_destroy(&b->not_full);
+  pthread_mutex_destroy(&b->lock);
+  free(threads);
+  free(b->ready);
+  free(b->items);
+
+  if (!ok) {
+    if (writer) {
+      pack_writer_abort(writer);
+    } else {
+      fclose(file);
+      unlink(filename);
+    }
+    exit(EXIT_FAILURE);
+  }
+  if (writer ? !pack_writer_close(writer) : fclose(file) != 0) {
+    fprintf(stderr, "Error: Cannot write %s.\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  fprintf(stderr, "%u games saved to %s in %.3f seconds (%.0f games/s).\n", b->count, filename, elapsed,
+          elapsed > 0 ? b->count / elapsed : 0.0);
+}
+
+/* ************************************************************************** */
 
 void usage(char* cmd) {
-  printf("Usage: %s <nb_rows> <nb_cols> <wrapping> <nb_empty> <nb_extra> <shuffle> [<filename>]\n", cmd);
+  printf("Usage: %s [--seed <seed>] [--unique] [--binary | --grid] [--difficulty <min> <max>] <nb_rows> <nb_cols> <wrapping> <nb_empty> <nb_extra> <shuffle> [<filename>]\n", cmd);
+  printf("       %s [--seed <seed>] --count <n> --out <filename> [--threads <t>] [--unique] [--binary | --pack] [--difficulty <min> <max>] <nb_rows> <nb_cols> <wrapping> <nb_empty> <nb_extra> <shuffle>\n", cmd);
   printf("Example: %s 4 4 0 0 0 0 random.sol\n", cmd);
+  printf("Example: %s --count 1000 --threads 4 --pack --out games.pack 15 15 0 0 0 1\n", cmd);
 }
 int main(int argc, char* argv[]) {
-  if (argc < 7 || argc > 8) {
+  uint64_t seed = time(NULL);
+  uint count = 0, nb_threads = 1;
+  bool unique = false, binary = false, grid = false, pack = false;
+  double min_difficulty = 0, max_difficulty = DBL_MAX;
+  char* out = NULL;
+
+  // options come first
+  int arg = 1;
+  while (arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+    if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc) {
+      seed = strtoull(argv[++arg], NULL, 10);
+    } else if (strcmp(argv[arg], "--count") == 0 && arg + 1 < argc) {
+      count = strtoul(argv[++arg], NULL, 10);
+    } else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc) {
+      nb_threads = strtoul(argv[++arg], NULL, 10);
+    } else if (strcmp(argv[arg], "--out") == 0 && arg + 1 < argc) {
+      out = argv[++arg];
+    } else if (strcmp(argv[arg], "--unique") == 0) {
+      unique = true;
+    } else if (strcmp(argv[arg], "--binary") == 0) {
+      binary = true;
+    } else if (strcmp(argv[arg], "--grid") == 0) {
+      grid = true;
+    } else if (strcmp(argv[arg], "--pack") == 0) {
+      pack = true;
+    } else if (strcmp(argv[arg], "--difficulty") == 0 && arg + 2 < argc) {
+      min_difficulty = strtod(argv[++arg], NULL);
+      max_difficulty = strtod(argv[++arg], NULL);
+    } else {
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+    arg++;
+  }
+  bool bulk_mode = (out != NULL);
+  if (argc - arg < 6 || argc - arg > (bulk_mode ? 6 : 7) || bulk_mode != (count > 0) || nb_threads == 0 ||
+      (pack && !bulk_mode) || (grid && (bulk_mode || binary))) {
     usage(argv[0]);
     exit(EXIT_FAILURE);
   }
-  int nb_rows = atoi(argv[1]);
-  int nb_cols = atoi(argv[2]);
-  int wrapping = atoi(argv[3]);
-  int nb_empty = atoi(argv[4]);
-  int nb_extra = atoi(argv[5]);
-  int shuffle = atoi(argv[6]);
+  int nb_rows = atoi(argv[arg]);
+  int nb_cols = atoi(argv[arg + 1]);
+  int wrapping = atoi(argv[arg + 2]);
+  int nb_empty = atoi(argv[arg + 3]);
+  int nb_extra = atoi(argv[arg + 4]);
+  int shuffle = atoi(argv[arg + 5]);
   char* filename = NULL;
-  if (argc == 8) {
-    filename = argv[7];
+  if (argc - arg == 7) {
+    filename = argv[arg + 6];
   }
-  srand(time(NULL));
-  game g = game_random(nb_rows, nb_cols, wrapping, nb_empty, nb_extra);
+  prng rng;
+  prng_seed(&rng, seed);
+  game g = game_random_ext(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, &rng);
   if (g == NULL) {
     fprintf(stderr, "Error: Cannot generate game_random.\n");
     exit(EXIT_FAILURE);
   }
+  if (bulk_mode) {
+    // the parameters are valid, since the first game could be generated
+    game_delete(g);
+    bulk b = {.nb_rows = nb_rows, .nb_cols = nb_cols, .nb_empty = nb_empty, .nb_extra = nb_extra,
+              .wrapping = wrapping, .shuffle = shuffle, .unique = unique, .min_difficulty = min_difficulty,
+              .max_difficulty = max_difficulty, .binary = binary, .pack = pack, .count = count};
+    _bulk_run(&b, nb_threads, seed, out);
+    return EXIT_SUCCESS;
+  }
+  if (unique || min_difficulty > 0 || max_difficulty < DBL_MAX) {
+    game_delete(g);
+    g = _generate(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, unique, min_difficulty, max_difficulty, &rng);
+    if (g == NULL) {
+      fprintf(stderr, "Error: Cannot generate a game with these constraints.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
   if (shuffle) {
-    game_shuffle_orientation(g);
+    game_shuffle_orientation_ext(g, &rng);
   }
   game_print(g);
   if (filename != NULL) {
-    game_save(g, filename);
+    bool ok = binary ? game_save_binary(g, filename) : grid ? game_save_grid(g, filename) : game_save(g, filename);
+    if (!ok) {
+      fprintf(stderr, "Error: Cannot save the game to %s.\n", filename);
+      exit(EXIT_FAILURE);
+    }
     fprintf(stderr, "Game saved to %s.\n", filename);
   }
   game_delete(g);
-}
\ No newline at end of file
+}
@@ -11,12 +11,16 @@
 #include "game.h"
 #include "game_aux.h"
 #include "game_ext.h"
+#include "game_journal.h"
+#include "game_pack.h"
 #include "game_private.h"
 #include "game_struct.h"
 #include "game_tools.h"
+#include "prng.h"
 
 #define FONT "images/arial.ttf"
 #define FONTSIZE 24
+#define INTEXT_SIZE 100
 #define BACKGROUND "images/background.jpg"
 #define IMG_CORNER "images/corner.png"
 #define IMG_TEE "images/tee.jpg"
@@ -24,6 +28,15 @@
 #define IMG_CROSS "images/cross.jpg"
 #define IMG_EMPTY "images/empty.jpg"
 #define IMG_ENDPOINT "images/endpoint.png"
+#define TILE_SIZE 256     // size of the pieces in the atlas
+#define GRID_COLOR 0xA0  // grey of the grid lines
+#define NOT_DRAWN 0xFF   // square not drawn yet in the board layer
+#define LOD_SIZE 4        // smaller squares (in pixels) are drawn as coloured pixels
+#define MAX_SIZE 256      // largest squares (in pixels) when zooming
+#define ZOOM_STEP 1.25f
+#define PAN_STEP 64  // pixels, for the arrow keys
+#define PROGRESS_DELAY 100  // ms between two refreshes of the solver progress
+#define NB_READY 4          // random games generated in advance
 
 /* **************************************************************** */
 typedef struct {
@@ -49,31 +62,67 @@ typedef struct {
   ButtonName btn_name;
 } UIButton;
 
-typedef struct {
-  int x, y;
-} coords;
+enum SolverEvent { SOLVER_PROGRESS, SOLVER_DONE };
 
 struct Env_t {
   game game;
+  pack pack;  // if not NULL, new random games are drawn from this pack
+  char *journal;  // if not NULL, the moves are recorded in this journal
   SDL_Texture *background;
-  SDL_Texture *corner;
-  SDL_Texture *tee;
-  SDL_Texture *segment;
-  SDL_Texture *cross;
-  SDL_Texture *endpoint;
-  SDL_Texture *empty;
-  coords **coord;
+  SDL_Texture *atlas;  // the pieces: one row per shape, one column per orientation
+  // batch of pieces, drawn at once from the atlas
+  SDL_Vertex *vertices;  // 4 per piece
+  int *indices;          // 6 per piece (2 triangles)
+  int batch_size, batch_max;
   int cols, rows;
+  // camera
+  bool fit;             // the whole board is fitted to the window
+  float cam_size;       // size of the squares in pixels
+  float cam_x, cam_y;   // position of the board in the window
+  bool panning;         // the middle button is down
+  int pan_x, pan_y;     // last position of the mouse while panning
+  // board layer: the grid and the visible pieces, drawn once in a texture, then patched
+  SDL_Texture *board;    // NULL if it must be built again
+  int board_w, board_h;  // size of the texture
+  int board_cell_size;   // size of the squares in the layer
+  int board_i0, board_j0, board_i1, board_j1;  // squares held in the layer
+  unsigned char *drawn;  // (shape << 2 | orientation) of each square drawn in the layer
+  // level of detail mode
+  SDL_Texture *lod;
+  int lod_w, lod_h;
+  Uint32 *lod_pixels;
   // for btns
   UIButton **btns;
   int nb_btn;
   // for input
   bool get_user_input;
   char *intext;
+  TTF_Font *input_font;
+  SDL_Texture *intext_texture;  // intext, rendered once (NULL if empty or changed)
   // message help
   char *help;
   SDL_Texture *win_msg;
   SDL_Texture *down_msg;
+  // background solver
+  SDL_Thread *solver;          // NULL if the game is not being solved
+  game solving;                // copy of the game, solved by the thread
+  bool solver_found;           // result of the thread, read once it is done
+  SDL_atomic_t solver_cancel;  // set to stop the thread
+  SDL_atomic_t solver_nodes;   // nodes explored so far
+  Uint32 solver_start, solver_last;  // start time, and last progress event (ms)
+  Uint32 solver_event;               // type of the events sent by the thread
+  // generator of the new random games, in a thread (NULL with a pack)
+  SDL_Thread *generator;
+  SDL_mutex *ready_lock;  // protects the ring and generator_stop
+  SDL_cond *ready_cond;   // signaled when a game is taken from the ring, or to stop
+  game ready[NB_READY];   // ring of shuffled games, ready to be played
+  int ready_first, nb_ready;
+  bool generator_stop;
+  prng generator_rng;  // used by the thread only
+  prng rng;            // used to generate a game right away, when the ring is empty
+  // rendering state
+  bool dirty;  // the window must be drawn again
+  bool won;    // game_won(), computed after each change of the game
 };
 
 /* **************************************************************** */
@@ -119,21 +168,49 @@ void draw_input_box(SDL_Renderer *ren, Env *env, int w, int h) {
   SDL_SetRenderDrawColor(ren, 0, 0, 0, 255);
   SDL_RenderDrawRect(ren, &inputbox);
 
-  // render text
-  SDL_Color color = {0, 0, 0, 255};
-  TTF_Font *font = TTF_OpenFont(FONT, FONTSIZE);
-  if (strlen(env->intext) > 0) {
-    SDL_Surface *surf = TTF_RenderText_Blended(font, env->intext, color);
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(ren, surf);
-
+  // render text, only when it has changed
+  if (!env->intext_texture && strlen(env->intext) > 0) {
+    SDL_Color color = {0, 0, 0, 255};
+    SDL_Surface *surf = TTF_RenderText_Blended(env->input_font, env->intext, color);
+    if (surf) {
+      env->intext_texture = SDL_CreateTextureFromSurface(ren, surf);
+      SDL_FreeSurface(surf);
+    }
+  }
+  if (env->intext_texture) {
     // putting text inside the input box
-    SDL_Rect text_rect = {inputbox.x + 5, inputbox.y + 5, surf->w, surf->h};
-    SDL_RenderCopy(ren, texture, NULL, &text_rect);
-
-    SDL_FreeSurface(surf);
-    SDL_DestroyTexture(texture);
+    SDL_Rect text_rect = {inputbox.x + 5, inputbox.y + 5, 0, 0};
+    SDL_QueryTexture(env->intext_texture, NULL, NULL, &text_rect.w, &text_rect.h);
+    SDL_RenderCopy(ren, env->intext_texture, NULL, &text_rect);
   }
-  TTF_CloseFont(font);
+}
+
+// draw the progress of the background solver
+void draw_solver_progress(SDL_Renderer *ren, Env *env, int w, int h) {
+  char text[100];
+  snprintf(text, sizeof(text), "Solving... %u nodes, %.1f s - [esc] to cancel", (uint)SDL_AtomicGet(&env->solver_nodes),
+           (SDL_GetTicks() - env->solver_start) / 1000.0);
+  SDL_Color color = {0, 0, 255, 255};
+  SDL_Surface *surf = TTF_RenderText_Blended(env->input_font, text, color);
+  if (!surf) return;
+  SDL_Texture *texture = SDL_CreateTextureFromSurface(ren, surf);
+  SDL_Rect rect = {(w - surf->w) / 2, h - 90, surf->w, surf->h};
+  SDL_FreeSurface(surf);
+  if (!texture) return;
+  SDL_RenderCopy(ren, texture, NULL, &rect);
+  SDL_DestroyTexture(texture);
+}
+
+// the input text has changed
+void intext_changed(Env *env) {
+  if (env->intext_texture) SDL_DestroyTexture(env->intext_texture);
+  env->intext_texture = NULL;
+}
+
+// the game has changed: compute its state again
+void game_changed(Env *env) {
+  env->won = game_won(env->game);
+  env->dirty = true;
 }
 
 UIButton *init_btn(UIButton *b, SDL_Renderer *ren, TTF_Font *font, char *text, SDL_Color color, SDL_Rect rect, ButtonName name) {
@@ -165,34 +242,189 @@ void update_button_positions(Env *env, int w) {
   }
 }
 
-/*free coords*/
-void free_coord(Env *env) {
-  if (env->coord) {
-    for (int i = 0; i < env->rows; i++) {
-      free(env->coord[i]);
-    }
-    free(env->coord);
+/* **************************************************************** */
+
+/* The board is kept in a target texture, with the shape and the orientation
+ * of each square drawn in it. At each frame, only the squares that changed
+ * since (a move, undo, redo, shuffle or solve) are drawn again, and the visible
+ * part of the layer is copied to the window at once. The layer holds a margin
+ * of a quarter of the window around the visible squares, drawn only when they
+ * become visible, so that panning inside it only draws the exposed strip. It
+ * is built again entirely when the size of the squares changes (resize, zoom),
+ * when the view leaves the layer or for a new game. */
+
+/* The pieces are drawn in an atlas at startup, in every orientation, so that
+ * the squares can be drawn from it without rotation, in batches of triangles
+ * (a single SDL_RenderGeometry call for the whole board). */
+
+#define PIXEL(surface, x, y) ((Uint32 *)((Uint8 *)(surface)->pixels + (y) * (surface)->pitch))[x]
+
+SDL_Texture *create_atlas(SDL_Renderer *ren) {
+  const char *paths[NB_SHAPES] = {[EMPTY] = IMG_EMPTY, [ENDPOINT] = IMG_ENDPOINT, [SEGMENT] = IMG_SEGMENT,
+                                  [CORNER] = IMG_CORNER, [TEE] = IMG_TEE,           [CROSS] = IMG_CROSS};
+  SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, NB_DIRS * TILE_SIZE, NB_SHAPES * TILE_SIZE, 32, SDL_PIXELFORMAT_RGBA32);
+  SDL_Surface *tile = SDL_CreateRGBSurfaceWithFormat(0, TILE_SIZE, TILE_SIZE, 32, SDL_PIXELFORMAT_RGBA32);
+  if (!atlas || !tile) ERROR("SDL_CreateRGBSurfaceWithFormat: %s\n", SDL_GetError());
+  for (int s = 0; s < NB_SHAPES; s++) {
+    SDL_Surface *image = IMG_Load(paths[s]);
+    if (!image) ERROR("IMG_Load: %s\n", paths[s]);
+    SDL_SetSurfaceBlendMode(image, SDL_BLENDMODE_NONE);  // copy the alpha channel too
+    SDL_BlitScaled(image, NULL, tile, NULL);
+    SDL_FreeSurface(image);
+    // rotate the tile clockwise, as SDL_RenderCopyEx()
+    for (int d = 0; d < NB_DIRS; d++)
+      for (int y = 0; y < TILE_SIZE; y++)
+        for (int x = 0; x < TILE_SIZE; x++) {
+          int rx = x, ry = y;
+          for (int k = 0; k < d; k++) {
+            int t = rx;
+            rx = TILE_SIZE - 1 - ry;
+            ry = t;
+          }
+          PIXEL(atlas, d * TILE_SIZE + rx, s * TILE_SIZE + ry) = PIXEL(tile, x, y);
+        }
   }
+  SDL_Texture *texture = SDL_CreateTextureFromSurface(ren, atlas);
+  if (!texture) ERROR("SDL_CreateTextureFromSurface: %s\n", SDL_GetError());
+  SDL_FreeSurface(tile);
+  SDL_FreeSurface(atlas);
+  return texture;
 }
 
-/*set coords*/
-void set_coord(Env *env, SDL_Window *win, int rows, int cols) {
-  env->rows = rows;
-  env->cols = cols;
-  // redefine coord
-  env->coord = malloc(env->rows * sizeof(coords *));
-  for (int i = 0; i < env->rows; i++) {
-    env->coord[i] = malloc(env->cols * sizeof(coords));
+/* add the piece of the square (i,j), drawn at (x,y), to the batch */
+void batch_piece(Env *env, int i, int j, float x, float y, float size) {
+  if (env->batch_size == env->batch_max) {
+    env->batch_max = env->batch_max ? 2 * env->batch_max : 64;
+    env->vertices = realloc(env->vertices, 4 * env->batch_max * sizeof(SDL_Vertex));
+    env->indices = realloc(env->indices, 6 * env->batch_max * sizeof(int));
+    if (!env->vertices || !env->indices) ERROR("Not enough memory\n");
   }
-  // update coord
-  int w, h;
-  SDL_GetWindowSize(win, &w, &h);
-  for (int i = 0; i < env->rows; i++) {
-    for (int j = 0; j < env->cols; j++) {
-      env->coord[i][j].x = (w / env->cols) * j;
-      env->coord[i][j].y = (h / env->rows) * i;
+  // tile of the piece, half a texel inside so that the next tiles do not bleed
+  float u0 = (game_get_piece_orientation(env->game, i, j) * TILE_SIZE + 0.5f) / (NB_DIRS * TILE_SIZE);
+  float v0 = (game_get_piece_shape(env->game, i, j) * TILE_SIZE + 0.5f) / (NB_SHAPES * TILE_SIZE);
+  float u1 = u0 + (TILE_SIZE - 1.0f) / (NB_DIRS * TILE_SIZE), v1 = v0 + (TILE_SIZE - 1.0f) / (NB_SHAPES * TILE_SIZE);
+  SDL_Color white = {255, 255, 255, 255};
+  SDL_Vertex *v = env->vertices + 4 * env->batch_size;
+  v[0] = (SDL_Vertex){{x, y}, white, {u0, v0}};
+  v[1] = (SDL_Vertex){{x + size, y}, white, {u1, v0}};
+  v[2] = (SDL_Vertex){{x + size, y + size}, white, {u1, v1}};
+  v[3] = (SDL_Vertex){{x, y + size}, white, {u0, v1}};
+  int *k = env->indices + 6 * env->batch_size, first = 4 * env->batch_size;
+  k[0] = first, k[1] = first + 1, k[2] = first + 2;
+  k[3] = first, k[4] = first + 2, k[5] = first + 3;
+  env->batch_size++;
+}
+
+/* draw the pieces of the batch, and empty it */
+void draw_batch(Env *env, SDL_Renderer *ren) {
+  if (env->batch_size > 0)
+    SDL_RenderGeometry(ren, env->atlas, env->vertices, 4 * env->batch_size, env->indices, 6 * env->batch_size);
+  env->batch_size = 0;
+}
+
+void invalidate_board(Env *env) {
+  if (env->board) SDL_DestroyTexture(env->board);
+  env->board = NULL;
+  free(env->drawn);
+  env->drawn = NULL;
+}
+
+/* **************************************************************** */
+
+/* a new game is played: draw it from scratch, fitted to the window */
+void set_game(Env *env, game g) {
+  if (env->game && env->game != g) game_delete(env->game);
+  env->game = g;
+  env->rows = game_nb_rows(g);
+  env->cols = game_nb_cols(g);
+  invalidate_board(env);
+  env->fit = true;
+  game_changed(env);
+}
+
+/* **************************************************************** */
+
+/* The new random games are generated in advance by a thread, which keeps a
+ * ring of NB_READY shuffled games full, so that [n] swaps one in at once. The
+ * games are drawn with the same parameters as before (random sizes up to
+ * 10x10), so the ring holds the next likely games; when it is empty, the game
+ * is generated right away. */
+
+game random_game(prng *rng) {
+  int new_rows = prng_uniform(rng, 10) + 1;
+  int new_cols = prng_uniform(rng, 10) + 1;
+  int wrapping = prng_uniform(rng, 2);
+  int nb_empty = prng_uniform(rng, 3);
+  int nb_extra = prng_uniform(rng, 3);
+  // keep at least two pieces, so that the generation cannot fail
+  if (new_rows * new_cols < 2) new_cols = 2;
+  if (nb_empty > new_rows * new_cols - 2) nb_empty = new_rows * new_cols - 2;
+  game g = game_random_ext(new_rows, new_cols, wrapping, nb_empty, nb_extra, rng);
+  if (!g) ERROR("game_random_ext: %dx%d\n", new_rows, new_cols);
+  game_shuffle_orientation_ext(g, rng);
+  return g;
+}
+
+static int generator_thread(void *data) {
+  Env *env = data;
+  SDL_LockMutex(env->ready_lock);
+  while (!env->generator_stop) {
+    if (env->nb_ready == NB_READY) {
+      SDL_CondWait(env->ready_cond, env->ready_lock);
+      continue;
     }
+    // generate without the lock, the UI thread may take a game meanwhile
+    SDL_UnlockMutex(env->ready_lock);
+    game g = random_game(&env->generator_rng);
+    SDL_LockMutex(env->ready_lock);
+    env->ready[(env->ready_first + env->nb_ready) % NB_READY] = g;
+    env->nb_ready++;
+  }
+  SDL_UnlockMutex(env->ready_lock);
+  return 0;
+}
+
+void start_generator(Env *env) {
+  env->nb_ready = env->ready_first = 0;
+  env->generator_stop = false;
+  env->generator_rng = env->rng;
+  prng_jump(&env->generator_rng);  // independent sequence
+  env->generator = NULL;
+  env->ready_lock = SDL_CreateMutex();
+  env->ready_cond = SDL_CreateCond();
+  if (env->ready_lock && env->ready_cond) env->generator = SDL_CreateThread(generator_thread, "generator", env);
+}
+
+/* take a game from the ring, returns NULL if it is empty */
+game take_ready_game(Env *env) {
+  if (!env->generator) return NULL;
+  game g = NULL;
+  SDL_LockMutex(env->ready_lock);
+  if (env->nb_ready > 0) {
+    g = env->ready[env->ready_first];
+    env->ready_first = (env->ready_first + 1) % NB_READY;
+    env->nb_ready--;
+    SDL_CondSignal(env->ready_cond);
+  }
+  SDL_UnlockMutex(env->ready_lock);
+  return g;
+}
+
+void stop_generator(Env *env) {
+  if (env->generator) {
+    SDL_LockMutex(env->ready_lock);
+    env->generator_stop = true;
+    SDL_CondSignal(env->ready_cond);
+    SDL_UnlockMutex(env->ready_lock);
+    SDL_WaitThread(env->generator, NULL);
+    env->generator = NULL;
   }
+  for (int k = 0; k < env->nb_ready; k++) game_delete(env->ready[(env->ready_first + k) % NB_READY]);
+  env->nb_ready = 0;
+  if (env->ready_cond) SDL_DestroyCond(env->ready_cond);
+  if (env->ready_lock) SDL_DestroyMutex(env->ready_lock);
+  env->ready_cond = NULL;
+  env->ready_lock = NULL;
 }
 
 /* **************************************************************** */
@@ -202,13 +434,45 @@ Env *init(SDL_Window *win, SDL_Renderer *ren, int argc, char *argv[]) {
   int w, h;
   SDL_GetWindowSize(win, &w, &h);
   game g = NULL;
+  env->pack = NULL;
+  env->journal = NULL;
+
+  // the moves may be recorded in a journal, given first
+  if (argc >= 3 && strcmp(argv[1], "--journal") == 0) {
+    env->journal = argv[2];
+    argc -= 2;
+    argv += 2;
+  }
 
-  // load game_default or chosen game
+  // load game_default or chosen game (the first one of a pack)
   if (argc == 1)
     g = game_default();
-  else if (argc == 2)
-    g = game_load(argv[1]);
+  else if (argc == 2 && pack_is_pack(argv[1])) {
+    env->pack = pack_open(argv[1]);
+    if (!env->pack || pack_count(env->pack) == 0) ERROR("%s: invalid or empty pack\n", argv[1]);
+    g = pack_get(env->pack, 0);
+    if (!g) ERROR("%s: corrupted game 0\n", argv[1]);
+  } else if (argc == 2) {
+    load_error err;
+    g = game_load_ext(argv[1], &err);
+    if (!g) ERROR("%s:%u:%u: %s\n", argv[1], err.line, err.col, game_load_error_message(err.status));
+  }
+
+  // resume the session recorded in the journal, if it exists
+  if (env->journal) {
+    load_error err;
+    game resumed = game_journal_open(env->journal, &err);
+    if (resumed) {
+      game_delete(g);
+      g = resumed;
+    } else if (err.status != LOAD_ERR_OPEN) {
+      ERROR("%s:%u:%u: %s\n", env->journal, err.line, err.col, game_load_error_message(err.status));
+    } else if (!game_journal_start(g, env->journal)) {
+      ERROR("%s: cannot create the journal\n", env->journal);
+    }
+  }
   env->game = g;
+  game_changed(env);
 
   /*set font*/
   SDL_Color color = {0, 0, 255, 255}; /* blue color in RGBA */
@@ -216,26 +480,36 @@ Env *init(SDL_Window *win, SDL_Renderer *ren, int argc, char *argv[]) {
   if (!font) ERROR("TTF_OpenFont: %s\n", FONT);
   TTF_SetFontStyle(font, TTF_STYLE_BOLD);  // TTF_STYLE_ITALIC | TTF_STYLE_NORMAL
 
-  // number of textures
-  int size = 7;
-
-  // All the textures in the structure env
-  const char *texture_paths[] = {BACKGROUND, IMG_CORNER, IMG_TEE, IMG_SEGMENT, IMG_CROSS, IMG_ENDPOINT, IMG_EMPTY};
-
-  SDL_Texture **textures[] = {&env->background, &env->corner, &env->tee, &env->segment, &env->cross, &env->endpoint, &env->empty};
-
   // Loading all the textures
-  for (int i = 0; i < size; i++) {
-    *textures[i] = IMG_LoadTexture(ren, texture_paths[i]);
-    if (!*textures[i]) {
-      ERROR("IMG_LoadTexture: %s\n", texture_paths[i]);
-    }
-  }
+  env->background = IMG_LoadTexture(ren, BACKGROUND);
+  if (!env->background) ERROR("IMG_LoadTexture: %s\n", BACKGROUND);
+  env->atlas = create_atlas(ren);
+  env->vertices = NULL;
+  env->indices = NULL;
+  env->batch_size = env->batch_max = 0;
 
   int cols = game_nb_cols(g);
   int rows = game_nb_rows(g);
 
-  set_coord(env, win, rows, cols);
+  env->board = NULL;
+  env->drawn = NULL;
+  env->lod = NULL;
+  env->lod_pixels = NULL;
+  env->panning = false;
+  env->solver = NULL;
+  env->solving = NULL;
+  env->solver_event = SDL_RegisterEvents(1);
+  env->rows = rows;
+  env->cols = cols;
+  env->fit = true;
+
+  // the new random games are generated in advance, but with a pack
+  env->generator = NULL;
+  env->ready_lock = NULL;
+  env->ready_cond = NULL;
+  env->nb_ready = 0;
+  prng_seed(&env->rng, ((uint64_t)rand() << 32) ^ (uint64_t)rand());
+  if (!env->pack) start_generator(env);
 
   /*init btns & intext &  help message*/
   env->help =
@@ -243,27 +517,31 @@ Env *init(SDL_Window *win, SDL_Renderer *ren, int argc, char *argv[]) {
       "Press key:\n"
       "- [n] new random game\n"
       "- [r] restart (shuffle)\n"
-      "- [s] solve\n"
+      "- [s] solve ([esc] to cancel)\n"
       "- [z] undo\n"
       "- [y] redo\n"
       "- [p] print\n"
       "- [e] toggle errors\n"
       "- [h] show help\n"
       "- [q] quit\n"
+      "Camera:\n"
+      "- [wheel] [+] [-] zoom\n"
+      "- [middle button] [arrows] move\n"
+      "- [f] whole board\n"
       "Save mode:\n"
       "- [esc] close save mode\n"
       "- [enter] save game in file\n";
 
-  SDL_Surface *surf = TTF_RenderText_Blended_Wrapped(font, env->help, color, 600);  // 600 = largeur max pour le wrapping
-  if (!surf) ERROR("TTF_RenderText_Blended_Wrapped: %s\n", TTF_GetError());
-
   // no input by default
   env->get_user_input = false;
 
-  // intext field
-  env->intext = malloc(sizeof(char) * 100);
+  // intext field, and its font opened once for all
+  env->intext = malloc(sizeof(char) * INTEXT_SIZE);
   if (!env->intext) ERROR("err malloc title\n");
   env->intext[0] = '\0';
+  env->intext_texture = NULL;
+  env->input_font = TTF_OpenFont(FONT, FONTSIZE);
+  if (!env->input_font) ERROR("TTF_OpenFont: %s\n", FONT);
 
   // number of buttons
   env->nb_btn = 5;
@@ -287,8 +565,10 @@ Env *init(SDL_Window *win, SDL_Renderer *ren, int argc, char *argv[]) {
   }
 
   // down screen msg
-  surf = TTF_RenderText_Blended(font, "Press [h] for help !", color);
+  SDL_Surface *surf = TTF_RenderText_Blended(font, "Press [h] for help !", color);
   env->down_msg = SDL_CreateTextureFromSurface(ren, surf);
+  SDL_FreeSurface(surf);
+  TTF_CloseFont(font);
 
   // win msg
   font = TTF_OpenFont(FONT, FONTSIZE * 5);
@@ -297,6 +577,7 @@ Env *init(SDL_Window *win, SDL_Renderer *ren, int argc, char *argv[]) {
   env->win_msg = SDL_CreateTextureFromSurface(ren, surf);
   SDL_FreeSurface(surf);
   TTF_CloseFont(font);
+  env->dirty = true;
   return env;
 }
 
@@ -310,28 +591,100 @@ void render_btn(UIButton *b, SDL_Renderer *ren, SDL_Rect *rect) {
   SDL_RenderCopy(ren, b->ltexture.texture, NULL, rect);
 }
 
-// calculate grid value
-void calc_grid(SDL_Renderer *ren, int cols, int rows, int *cell_w, int *cell_h, int *need_w, int *need_h, int *start_x, int *start_y,
-               int *cell_size) {
+/* The camera gives the size of the squares and the position of the board in
+ * the window. By default, the board is fitted in 80% of the window; the user
+ * may then zoom (wheel, [+] [-]) and pan (middle button, arrows), and [f]
+ * fits the board again. Only the visible squares are drawn: as sprites from
+ * the board layer when they are large enough, else as one coloured pixel per
+ * square (or per group of squares) in the level of detail mode. */
+
+static int ifloor(float v) {
+  int i = (int)v;
+  return i - (v < i);
+}
+
+/* size of the squares when the whole board is fitted in 80% of the window */
+float fitted_size(Env *env, SDL_Renderer *ren) {
+  int w, h;
+  SDL_GetRendererOutputSize(ren, &w, &h);
+  float size_w = w * 0.8f / env->cols, size_h = h * 0.8f / env->rows;
+  float size = (size_w < size_h) ? size_w : size_h;
+  return (size >= LOD_SIZE) ? (int)size : size;
+}
+
+/* keep the board center in the window, and the board on whole pixels when the pieces are drawn */
+void clamp_camera(Env *env, SDL_Renderer *ren) {
+  int w, h;
+  SDL_GetRendererOutputSize(ren, &w, &h);
+  float half_w = env->cam_size * env->cols / 2, half_h = env->cam_size * env->rows / 2;
+  if (env->cam_x + half_w < 0) env->cam_x = -half_w;
+  if (env->cam_x + half_w > w) env->cam_x = w - half_w;
+  if (env->cam_y + half_h < 0) env->cam_y = -half_h;
+  if (env->cam_y + half_h > h) env->cam_y = h - half_h;
+  if (env->cam_size >= LOD_SIZE) {
+    env->cam_x = ifloor(env->cam_x);
+    env->cam_y = ifloor(env->cam_y);
+  }
+}
+
+/* compute the camera again if the board is fitted to the window */
+void update_camera(Env *env, SDL_Renderer *ren) {
+  if (!env->fit) return;
   int w, h;
   SDL_GetRendererOutputSize(ren, &w, &h);
-  // Définir la zone de la grille (ex : 80% de la fenêtre)
-  float scale = 0.8;
-  int grid_w = w * scale;
-  int grid_h = h * scale;
+  env->cam_size = fitted_size(env, ren);
+  env->cam_x = (w - env->cam_size * env->cols) / 2;
+  env->cam_y = (h - env->cam_size * env->rows) / 2;
+  clamp_camera(env, ren);
+}
+
+/* zoom in (factor > 1) or out, keeping the point (x,y) of the window in place */
+void zoom_camera(Env *env, SDL_Renderer *ren, float factor, int x, int y) {
+  update_camera(env, ren);
+  float old_size = env->cam_size, size = old_size * factor;
+  if (size > MAX_SIZE) size = MAX_SIZE;
+  if (size >= LOD_SIZE) size = (int)size;
+  if (size <= fitted_size(env, ren)) {
+    // the whole board is visible again
+    env->fit = true;
+    update_camera(env, ren);
+    return;
+  }
+  env->fit = false;
+  env->cam_size = size;
+  env->cam_x = x - (x - env->cam_x) * size / old_size;
+  env->cam_y = y - (y - env->cam_y) * size / old_size;
+  clamp_camera(env, ren);
+}
 
-  // size and be a square
-  *cell_w = grid_w / cols;
-  *cell_h = grid_h / rows;
-  *cell_size = (*cell_w < *cell_h) ? *cell_w : *cell_h;
+void pan_camera(Env *env, SDL_Renderer *ren, int dx, int dy) {
+  update_camera(env, ren);
+  env->fit = false;
+  env->cam_x += dx;
+  env->cam_y += dy;
+  clamp_camera(env, ren);
+}
 
-  // needed size
-  *need_w = (*cell_size) * cols;
-  *need_h = (*cell_size) * rows;
+/* visible squares: rows from *i0 to *i1 (excluded), columns from *j0 to *j1 (excluded) */
+void visible_squares(Env *env, SDL_Renderer *ren, int *i0, int *j0, int *i1, int *j1) {
+  int w, h;
+  SDL_GetRendererOutputSize(ren, &w, &h);
+  *j0 = ifloor(-env->cam_x / env->cam_size);
+  *i0 = ifloor(-env->cam_y / env->cam_size);
+  *j1 = -ifloor(-(w - env->cam_x) / env->cam_size);  // rounded up
+  *i1 = -ifloor(-(h - env->cam_y) / env->cam_size);
+  if (*j0 < 0) *j0 = 0;
+  if (*i0 < 0) *i0 = 0;
+  if (*j1 > env->cols) *j1 = env->cols;
+  if (*i1 > env->rows) *i1 = env->rows;
+}
 
-  // begin (x,y)
-  *start_x = (w - *need_w) / 2;
-  *start_y = (h - *need_h) / 2;
+/* square at the point (x,y) of the window, returns false if there is none */
+bool square_at(Env *env, SDL_Renderer *ren, int x, int y, int *i, int *j) {
+  update_camera(env, ren);
+  *j = ifloor((x - env->cam_x) / env->cam_size);
+  *i = ifloor((y - env->cam_y) / env->cam_size);
+  return *i >= 0 && *i < env->rows && *j >= 0 && *j < env->cols;
 }
 
 void create_grid(Env *env, SDL_Renderer *ren, int cols, int rows, int start_x, int start_y, int need_h, int need_w, int cell_size) {
@@ -350,49 +703,135 @@ void create_grid(Env *env, SDL_Renderer *ren, int cols, int rows, int start_x, i
   }
 }
 
+/* draw the board layer again where the game changed, for the visible squares,
+ * returns false if the renderer has no target texture */
+bool update_board(Env *env, SDL_Renderer *ren, int cell_size, int i0, int j0, int i1, int j1) {
+  bool full = !env->drawn || cell_size != env->board_cell_size || i0 < env->board_i0 || j0 < env->board_j0 ||
+              i1 > env->board_i1 || j1 > env->board_j1;
+  if (full) {
+    // center the layer on the view, with a margin of a quarter of the window
+    int w, h;
+    SDL_GetRendererOutputSize(ren, &w, &h);
+    int margin_i = h / 4 / cell_size + 1, margin_j = w / 4 / cell_size + 1;
+    env->board_i0 = i0 > margin_i ? i0 - margin_i : 0;
+    env->board_j0 = j0 > margin_j ? j0 - margin_j : 0;
+    env->board_i1 = i1 + margin_i < env->rows ? i1 + margin_i : env->rows;
+    env->board_j1 = j1 + margin_j < env->cols ? j1 + margin_j : env->cols;
+  }
+  int nb_rows = env->board_i1 - env->board_i0, nb_cols = env->board_j1 - env->board_j0;
+  int need_w = nb_cols * cell_size, need_h = nb_rows * cell_size;
+  // one more pixel for the last lines of the grid
+  if (!env->board || env->board_w < need_w + 1 || env->board_h < need_h + 1) {
+    if (env->board) SDL_DestroyTexture(env->board);
+    env->board_w = need_w + 1, env->board_h = need_h + 1;
+    env->board = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, env->board_w, env->board_h);
+    if (!env->board) {
+      invalidate_board(env);
+      return false;
+    }
+    SDL_SetTextureBlendMode(env->board, SDL_BLENDMODE_BLEND);
+    full = true;
+  }
+  if (full) {
+    free(env->drawn);
+    env->drawn = malloc(nb_rows * nb_cols);
+    if (!env->drawn) ERROR("Not enough memory\n");
+    memset(env->drawn, NOT_DRAWN, nb_rows * nb_cols);
+    env->board_cell_size = cell_size;
+  }
+  if (SDL_SetRenderTarget(ren, env->board) != 0) {
+    invalidate_board(env);
+    return false;
+  }
+  SDL_SetRenderDrawBlendMode(ren, SDL_BLENDMODE_NONE);
+  if (full) {
+    SDL_SetRenderDrawColor(ren, 0, 0, 0, 0);
+    SDL_RenderClear(ren);
+    SDL_SetRenderDrawColor(ren, GRID_COLOR, GRID_COLOR, GRID_COLOR, 255);
+    create_grid(env, ren, nb_cols, nb_rows, 0, 0, need_h, need_w, cell_size);
+  }
+  // the squares of the margin are drawn when they become visible
+  for (int i = i0; i < i1; i++) {
+    for (int j = j0; j < j1; j++) {
+      unsigned char code = game_get_piece_shape(env->game, i, j) << 2 | game_get_piece_orientation(env->game, i, j);
+      unsigned char *drawn = &env->drawn[(i - env->board_i0) * nb_cols + (j - env->board_j0)];
+      if (*drawn == code) continue;
+      int x = (j - env->board_j0) * cell_size, y = (i - env->board_i0) * cell_size;
+      if (!full) {
+        // erase the old piece, and draw the lines of the grid it covered
+        SDL_Rect cell = {x, y, cell_size, cell_size};
+        SDL_SetRenderDrawColor(ren, 0, 0, 0, 0);
+        SDL_RenderFillRect(ren, &cell);
+        SDL_SetRenderDrawColor(ren, GRID_COLOR, GRID_COLOR, GRID_COLOR, 255);
+        SDL_RenderDrawLine(ren, x, y, x + cell_size, y);
+        SDL_RenderDrawLine(ren, x, y, x, y + cell_size);
+      }
+      batch_piece(env, i, j, x, y, cell_size);
+      *drawn = code;
+    }
+  }
+  draw_batch(env, ren);
+  SDL_SetRenderTarget(ren, NULL);
+  return true;
+}
+
+/* draw the visible squares as coloured pixels, at most one texel per pixel of the window */
+void draw_lod(Env *env, SDL_Renderer *ren, int i0, int j0, int i1, int j1) {
+  static const Uint32 colors[NB_SHAPES] = {[EMPTY] = 0x303030FF,  [ENDPOINT] = 0xE04040FF, [SEGMENT] = 0x40A0E0FF,
+                                           [CORNER] = 0x40C060FF, [TEE] = 0xE0C040FF,      [CROSS] = 0xC060E0FF};
+  int w, h;
+  SDL_GetRendererOutputSize(ren, &w, &h);
+  if (!env->lod || env->lod_w < w || env->lod_h < h) {
+    if (env->lod) SDL_DestroyTexture(env->lod);
+    free(env->lod_pixels);
+    env->lod_w = w, env->lod_h = h;
+    env->lod = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+    env->lod_pixels = malloc(w * h * sizeof(Uint32));
+    if (!env->lod || !env->lod_pixels) ERROR("Cannot create the level of detail texture\n");
+  }
+  int tw = (j1 - j0 < w) ? j1 - j0 : w, th = (i1 - i0 < h) ? i1 - i0 : h;
+  for (int y = 0; y < th; y++) {
+    int i = i0 + (long)y * (i1 - i0) / th;
+    for (int x = 0; x < tw; x++) {
+      int j = j0 + (long)x * (j1 - j0) / tw;
+      env->lod_pixels[y * tw + x] = colors[game_get_piece_shape(env->game, i, j)];
+    }
+  }
+  SDL_Rect src = {0, 0, tw, th};
+  SDL_UpdateTexture(env->lod, &src, env->lod_pixels, tw * sizeof(Uint32));
+  int x0 = ifloor(env->cam_x + j0 * env->cam_size), y0 = ifloor(env->cam_y + i0 * env->cam_size);
+  SDL_Rect dest = {x0, y0, ifloor(env->cam_x + j1 * env->cam_size) - x0, ifloor(env->cam_y + i1 * env->cam_size) - y0};
+  SDL_RenderCopy(ren, env->lod, &src, &dest);
+}
+
 void render(SDL_Window *win, SDL_Renderer *ren, Env *env) {
   SDL_Rect rect;
   int w, h;
   SDL_GetWindowSize(win, &w, &h);
   SDL_RenderCopy(ren, env->background, NULL, NULL); /* stretch it */
-  // get grid value & create grid
-  int cell_w, cell_h, need_w, need_h, start_x, start_y, cell_size;
-  calc_grid(ren, env->cols, env->rows, &cell_w, &cell_h, &need_w, &need_h, &start_x, &start_y, &cell_size);
-  create_grid(env, ren, env->cols, env->rows, start_x, start_y, need_h, need_w, cell_size);
-  for (int i = 0; i < env->rows; i++) {
-    for (int j = 0; j < env->cols; j++) {
-      shape p = game_get_piece_shape(env->game, i, j);
-      SDL_Texture *texture = NULL;
-      // Déterminer le type de la pièce
-      switch (p) {
-        case CORNER:
-          texture = env->corner;
-          break;
-        case TEE:
-          texture = env->tee;
-          break;
-        case ENDPOINT:
-          texture = env->endpoint;
-          break;
-        case CROSS:
-          texture = env->cross;
-          break;
-        case SEGMENT:
-          texture = env->segment;
-          break;
-        default:
-          texture = env->empty;
-          break;
-      }
-
-      // la position de la pièce sur la grille
-      SDL_Rect dest = {start_x + j * cell_size, start_y + i * cell_size, cell_size, cell_size};
-
-      // Afficher la pièce
-      if (texture) {
-        int angle = game_get_piece_orientation(env->game, i, j) * 90;
-        SDL_RenderCopyEx(ren, texture, NULL, &dest, angle, NULL, SDL_FLIP_NONE);
-      }
+  // draw the visible squares
+  int i0, j0, i1, j1;
+  update_camera(env, ren);
+  visible_squares(env, ren, &i0, &j0, &i1, &j1);
+  if (i0 < i1 && j0 < j1 && env->cam_size < LOD_SIZE) {
+    draw_lod(env, ren, i0, j0, i1, j1);
+  } else if (i0 < i1 && j0 < j1) {
+    int cell_size = env->cam_size;
+    int start_x = env->cam_x + j0 * cell_size, start_y = env->cam_y + i0 * cell_size;
+    int need_w = (j1 - j0) * cell_size, need_h = (i1 - i0) * cell_size;
+    if (update_board(env, ren, cell_size, i0, j0, i1, j1)) {
+      int x = (j0 - env->board_j0) * cell_size, y = (i0 - env->board_i0) * cell_size;
+      SDL_Rect src = {x, y, need_w + 1, need_h + 1};
+      SDL_Rect dest = {start_x, start_y, need_w + 1, need_h + 1};
+      SDL_RenderCopy(ren, env->board, &src, &dest);
+    } else {
+      // no target texture: draw the board directly
+      SDL_SetRenderDrawColor(ren, GRID_COLOR, GRID_COLOR, GRID_COLOR, 255);
+      create_grid(env, ren, j1 - j0, i1 - i0, start_x, start_y, need_h, need_w, cell_size);
+      for (int i = i0; i < i1; i++)
+        for (int j = j0; j < j1; j++)
+          batch_piece(env, i, j, start_x + (j - j0) * cell_size, start_y + (i - i0) * cell_size, cell_size);
+      draw_batch(env, ren);
     }
   }
 
@@ -410,19 +849,104 @@ void render(SDL_Window *win, SDL_Renderer *ren, Env *env) {
   rect.y = h - 50;
   SDL_RenderCopy(ren, env->down_msg, NULL, &rect);
 
+  /*render solver progress*/
+  if (env->solver) draw_solver_progress(ren, env, w, h);
+
   /*render win msg*/
-  if (game_won(env->game)) {
+  if (env->won) {
     SDL_QueryTexture(env->win_msg, NULL, NULL, &rect.w, &rect.h);
     rect.x = (w - rect.w) / 2;
     rect.y = (h - rect.h) / 2;
     SDL_RenderCopy(ren, env->win_msg, NULL, &rect);
   }
+  env->dirty = false;
 }
 
+bool need_render(Env *env) { return env->dirty; }
+
 /* **************************************************************** */
 // handle input event
+/* **************************************************************** */
+
+/* The game is solved in a thread, on a copy of the game, so that the window
+ * stays responsive. The thread sends an event to refresh its progress (nodes
+ * explored, elapsed time) every PROGRESS_DELAY ms, and another one once done;
+ * the solution is then played as moves, so that they can be undone. Meanwhile,
+ * the game cannot be changed, and [esc] stops the thread. */
+
+static bool solver_progress_cb(const game_stats *stats, void *data) {
+  Env *env = data;
+  SDL_AtomicSet(&env->solver_nodes, stats->nb_nodes);
+  Uint32 now = SDL_GetTicks();
+  if (now - env->solver_last >= PROGRESS_DELAY) {
+    env->solver_last = now;
+    SDL_Event e = {.user = {.type = env->solver_event, .code = SOLVER_PROGRESS}};
+    SDL_PushEvent(&e);
+  }
+  return !SDL_AtomicGet(&env->solver_cancel);
+}
+
+static int solver_thread(void *data) {
+  Env *env = data;
+  env->solver_found = game_solve_progress(env->solving, solver_progress_cb, env, NULL);
+  SDL_Event e = {.user = {.type = env->solver_event, .code = SOLVER_DONE}};
+  SDL_PushEvent(&e);
+  return 0;
+}
+
+/* play the moves from the game to its solution */
+void apply_solution(Env *env) {
+  for (int i = 0; i < env->rows; i++)
+    for (int j = 0; j < env->cols; j++) {
+      int turns = (game_get_piece_orientation(env->solving, i, j) - game_get_piece_orientation(env->game, i, j) + NB_DIRS) % NB_DIRS;
+      if (turns != 0) game_play_move(env->game, i, j, turns == 3 ? -1 : turns);
+    }
+}
+
+// the thread is done (or stopped): apply its solution
+void finish_solver(Env *env) {
+  if (env->solver) SDL_WaitThread(env->solver, NULL);
+  env->solver = NULL;
+  if (env->solver_found)
+    apply_solution(env);
+  else if (!SDL_AtomicGet(&env->solver_cancel))
+    PRINT("No solution found\n");
+  game_delete(env->solving);
+  env->solving = NULL;
+  game_changed(env);
+}
+
+void start_solver(Env *env) {
+  if (env->solver) return;
+  env->solving = game_copy(env->game);
+  SDL_AtomicSet(&env->solver_cancel, 0);
+  SDL_AtomicSet(&env->solver_nodes, 0);
+  env->solver_start = env->solver_last = SDL_GetTicks();
+  if (env->solver_event != (Uint32)-1) env->solver = SDL_CreateThread(solver_thread, "solver", env);
+  if (!env->solver) {
+    // no thread: solve right away
+    env->solver_found = game_solve(env->solving);
+    finish_solver(env);
+  }
+}
+
+// stop the thread, without applying its solution
+void stop_solver(Env *env) {
+  if (!env->solver) return;
+  SDL_AtomicSet(&env->solver_cancel, 1);
+  SDL_WaitThread(env->solver, NULL);
+  env->solver = NULL;
+  game_delete(env->solving);
+  env->solving = NULL;
+}
+
+/* **************************************************************** */
+
 void handle_input(Env *env, SDL_Event *e) {
-  if (e->type == SDL_TEXTINPUT) strncat(env->intext, e->text.text, sizeof(env->intext) - strlen(env->intext) - 1);
+  if (e->type == SDL_TEXTINPUT) {
+    strncat(env->intext, e->text.text, INTEXT_SIZE - strlen(env->intext) - 1);
+    intext_changed(env);
+  }
 
   if (e->type == SDL_KEYDOWN) {
     SDL_Keycode k = e->key.keysym.sym;
@@ -435,6 +959,7 @@ void handle_input(Env *env, SDL_Event *e) {
     if (k == SDLK_BACKSPACE) {
       int l = strlen(env->intext);
       if (l > 0) env->intext[l - 1] = '\0';
+      intext_changed(env);
     }
     // writing done
     if (k == SDLK_RETURN) {
@@ -442,38 +967,25 @@ void handle_input(Env *env, SDL_Event *e) {
       env->get_user_input = false;
       if (!env->intext || strlen(env->intext) == 0) {
         // default saving path
-        game_save(env->game, "saved_game");
+        if (!game_save(env->game, "saved_game")) PRINT("Cannot save the game in saved_game\n");
       } else {
-        game_save(env->game, env->intext);
+        if (!game_save(env->game, env->intext)) PRINT("Cannot save the game in %s\n", env->intext);
         // errase the input after its use
         env->intext[0] = '\0';
+        intext_changed(env);
       };
     }
   }
 }
 
 void handle_random(SDL_Window *win, Env *env) {
-  // get new random game
-  int new_rows = rand() % 10 + 1;
-  int new_cols = rand() % 10 + 1;
-  int wrapping = rand() % 2;
-  int nb_empty = rand() % 3;
-  int nb_extra = rand() % 3;
-  game_delete(env->game);
-  env->game = game_random(new_rows, new_cols, wrapping, nb_empty, nb_extra);
-  if (env->game == NULL) {
-    env->game = game_random(new_rows, new_cols, wrapping, 0, 0);
-    if (env->game == NULL) {
-      env->game = game_default();
-    }
-  }
-  game_shuffle_orientation(env->game);
-
-  // free old coord
-  free_coord(env);
-
-  // set new coord
-  set_coord(env, win, new_rows, new_cols);
+  // draw a game from the pack, if any
+  game g = env->pack ? pack_get(env->pack, rand() % pack_count(env->pack)) : NULL;
+  // else take a game generated in advance, or generate it now
+  if (!g) g = take_ready_game(env);
+  if (!g) g = random_game(&env->rng);
+  set_game(env, g);
+  if (env->journal && !game_journal_start(g, env->journal)) PRINT("Cannot write the journal %s\n", env->journal);
 }
 
 bool process(SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e) {
@@ -483,6 +995,25 @@ bool process(SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e) {
   /* quit */
   if (e->type == SDL_QUIT) return true;
 
+  /* every event but the mouse motions may change what is displayed (buttons, input box, window) */
+  if (e->type == SDL_WINDOWEVENT || e->type == SDL_KEYDOWN || e->type == SDL_TEXTINPUT || e->type == SDL_MOUSEBUTTONDOWN ||
+      e->type == SDL_MOUSEBUTTONUP)
+    env->dirty = true;
+
+  /* background solver: progress or done */
+  if (e->type == env->solver_event) {
+    if (e->user.code == SOLVER_DONE) finish_solver(env);
+    env->dirty = true;
+  }
+  if (env->solver && e->type == SDL_KEYDOWN && e->key.keysym.sym == SDLK_ESCAPE) SDL_AtomicSet(&env->solver_cancel, 1);
+  bool idle = !env->solver;  // the game may be changed
+
+  /* the content of the target textures may be lost */
+  if (e->type == SDL_RENDER_TARGETS_RESET || e->type == SDL_RENDER_DEVICE_RESET) {
+    invalidate_board(env);
+    env->dirty = true;
+  }
+
   /*resize event*/
   if (e->type == SDL_WINDOWEVENT) {
     if (e->window.event == SDL_WINDOWEVENT_RESIZED) {
@@ -508,15 +1039,18 @@ bool process(SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e) {
         if (on_topbtn) {
           env->btns[i]->status = UI_RELEASED;
           ButtonName n = env->btns[i]->btn_name;
+          if (!idle && n != BTN_GAME_SAVE) continue;
 
           /////things to be done after pressed btn
-          if (n == BTN_UNDO) game_undo(env->game);
-          if (n == BTN_REDO) game_redo(env->game);
-          if (n == BTN_GAME_SOLVE) {
-            game_solve(env->game);
-            render(win, ren, env);
-            SDL_RenderPresent(ren);
+          if (n == BTN_UNDO) {
+            game_undo(env->game);
+            game_changed(env);
+          }
+          if (n == BTN_REDO) {
+            game_redo(env->game);
+            game_changed(env);
           }
+          if (n == BTN_GAME_SOLVE) start_solver(env);
           if (n == BTN_GAME_SAVE) {
             SDL_StartTextInput();
             env->get_user_input = true;
@@ -535,48 +1069,78 @@ bool process(SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e) {
     // 9 keys to be detected
     SDL_Keycode k = e->key.keysym.sym;
     /* z -> undo*/
-    if (k == SDLK_z) game_undo(env->game);
+    if (k == SDLK_z && idle) {
+      game_undo(env->game);
+      game_changed(env);
+    }
     /* y -> redo*/
-    if (k == SDLK_y) game_redo(env->game);
+    if (k == SDLK_y && idle) {
+      game_redo(env->game);
+      game_changed(env);
+    }
     /* r -> shuffle*/
-    if (k == SDLK_r) game_shuffle_orientation(env->game);
+    if (k == SDLK_r && idle) {
+      game_shuffle_orientation(env->game);
+      game_changed(env);
+    }
     /* q -> quit*/
     if (k == SDLK_q) return true;
     /* h -> help*/
     if (k == SDLK_h) SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_INFORMATION, "Help", env->help, win);
     /* s -> solve*/
-    if (k == SDLK_s) {
-      game_solve(env->game);
-      render(win, ren, env);
-      SDL_RenderPresent(ren);
-    }
+    if (k == SDLK_s && idle) start_solver(env);
     /* p -> print*/
     if (k == SDLK_p) game_print(env->game);
     /* e -> toggle_errors*/
     if (k == SDLK_e) SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, "Error", "key 'e' is not available\n", win);
     /* n -> new random game*/
-    if (k == SDLK_n) handle_random(win, env);
+    if (k == SDLK_n && idle) handle_random(win, env);
   }
 
-  // handle game operation
-  if (e->type == SDL_MOUSEBUTTONDOWN) {
-    // get grid info
-    int start_x, start_y, cell_size, need_w, need_h, cell_w, cell_h;
-    calc_grid(ren, env->cols, env->rows, &cell_w, &cell_h, &need_w, &need_h, &start_x, &start_y, &cell_size);
-    int end_x = start_x + need_w, end_y = start_y + need_h;
+  // handle camera
+  if (e->type == SDL_MOUSEWHEEL && e->wheel.y != 0) {
+    zoom_camera(env, ren, e->wheel.y > 0 ? ZOOM_STEP : 1 / ZOOM_STEP, x, y);
+    env->dirty = true;
+  }
+  if (e->type == SDL_MOUSEBUTTONDOWN && e->button.button == SDL_BUTTON_MIDDLE) {
+    env->panning = true;
+    env->pan_x = e->button.x, env->pan_y = e->button.y;
+  }
+  if (e->type == SDL_MOUSEBUTTONUP && e->button.button == SDL_BUTTON_MIDDLE) env->panning = false;
+  if (e->type == SDL_MOUSEMOTION && env->panning) {
+    pan_camera(env, ren, e->motion.x - env->pan_x, e->motion.y - env->pan_y);
+    env->pan_x = e->motion.x, env->pan_y = e->motion.y;
+    env->dirty = true;
+  }
+  if (e->type == SDL_KEYDOWN && !env->get_user_input) {
+    int w, h;
+    SDL_GetRendererOutputSize(ren, &w, &h);
+    SDL_Keycode k = e->key.keysym.sym;
+    if (k == SDLK_PLUS || k == SDLK_EQUALS || k == SDLK_KP_PLUS) zoom_camera(env, ren, ZOOM_STEP, w / 2, h / 2);
+    if (k == SDLK_MINUS || k == SDLK_KP_MINUS) zoom_camera(env, ren, 1 / ZOOM_STEP, w / 2, h / 2);
+    if (k == SDLK_LEFT) pan_camera(env, ren, PAN_STEP, 0);
+    if (k == SDLK_RIGHT) pan_camera(env, ren, -PAN_STEP, 0);
+    if (k == SDLK_UP) pan_camera(env, ren, 0, PAN_STEP);
+    if (k == SDLK_DOWN) pan_camera(env, ren, 0, -PAN_STEP);
+    if (k == SDLK_f) env->fit = true;
+  }
 
+  // handle game operation, below the buttons
+  if (e->type == SDL_MOUSEBUTTONDOWN && y > btn_area && idle) {
     // Vérifie que le clic est dans la grille
-    if (x >= start_x && x <= end_x && y >= start_y && y <= end_y) {
-      int col = (x - start_x) / cell_size, row = (y - start_y) / cell_size;
+    int row, col;
+    if (square_at(env, ren, x, y, &row, &col)) {
       if (e->button.button == SDL_BUTTON_LEFT) {
         game_play_move(env->game, row, col, 1);
       } else if (e->button.button == SDL_BUTTON_RIGHT) {
         game_play_move(env->game, row, col, -1);
       }
-      render(win, ren, env);
-      SDL_RenderPresent(ren);
+      game_changed(env);
     }
   }
+
+  // the moves are played at the pace of the user, so record them right away
+  if (!game_journal_flush(env->game)) PRINT("Cannot write the journal %s\n", env->journal);
   return false;
 }
 
@@ -585,12 +1149,12 @@ bool process(SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e) {
 //
 void clean(SDL_Window *win, SDL_Renderer *ren, Env *env) {
   if (!env) return;
+  stop_solver(env);
   // All the textures in the structure env
-  SDL_Texture *textures[] = {env->background, env->corner, env->tee,      env->segment, env->cross,
-                             env->endpoint,   env->empty,  env->down_msg, env->win_msg};
+  SDL_Texture *textures[] = {env->background, env->atlas, env->down_msg, env->win_msg};
 
   // The number of textures
-  int size = 9;
+  int size = 4;
 
   for (int i = 0; i < size; i++) {
     if (textures[i]) {
@@ -598,7 +1162,12 @@ void clean(SDL_Window *win, SDL_Renderer *ren, Env *env) {
     }
   }
 
-  free_coord(env);
+  stop_generator(env);
+  invalidate_board(env);
+  free(env->vertices);
+  free(env->indices);
+  if (env->lod) SDL_DestroyTexture(env->lod);
+  free(env->lod_pixels);
 
   // Free all the buttons
   if (env->btns) {
@@ -616,8 +1185,11 @@ void clean(SDL_Window *win, SDL_Renderer *ren, Env *env) {
   if (env->game) {
     game_delete(env->game);
   }
+  pack_close(env->pack);
 
   if (env->intext != NULL) free(env->intext);
+  if (env->intext_texture) SDL_DestroyTexture(env->intext_texture);
+  if (env->input_font) TTF_CloseFont(env->input_font);
   free(env);
 }
 
@@ -42,7 +42,6 @@ typedef struct Env_t Env;
 #define APP_NAME "SDL2 Demo"
 #define SCREEN_WIDTH 1000
 #define SCREEN_HEIGHT 1000
-#define DELAY 100
 
 /* **************************************************************** */
 
@@ -50,6 +49,7 @@ Env *init( SDL_Window *win, SDL_Renderer *ren, int argc, char *argv[] );
 void render( SDL_Window *win, SDL_Renderer *ren, Env *env );
 void clean( SDL_Window *win, SDL_Renderer *ren, Env *env );
 bool process( SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e );
+bool need_render( Env *env ); /* something has changed since the last render */
 
 /* **************************************************************** */
 
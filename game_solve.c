@@ -1,39 +1,587 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "game.h"
 #include "game_aux.h"
+#include "game_ext.h"
+#include "game_pack.h"
 #include "game_tools.h"
 
+/** wall-clock time, in seconds */
+static double _now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* ************************************************************************** */
+/*                              SOLUTION CACHE                                */
+/* ************************************************************************** */
+
+/* The cache is a directory holding one file per puzzle, named after a hash of
+ * everything the solver depends on (size, wrapping option and shapes, but not
+ * the orientations). The ".sol" entry stores the solved game in the usual text
+ * format, the ".nb" entry stores the puzzle (size, wrapping option and shapes)
+ * then its number of solutions. On a hit, the puzzle of the entry is compared
+ * with the searched one, to guard against hash collisions. */
+
+#define CACHE_ENV "GAME_SOLVE_CACHE"
+
+typedef enum {
+  CACHE_USE,    /* read the cache, write it on miss */
+  CACHE_BYPASS, /* do not touch the cache */
+  CACHE_VERIFY, /* always solve, compare with the cache and rewrite it */
+} cache_mode;
+
+typedef enum {
+  ENTRY_MISSING,
+  ENTRY_INVALID, /* corrupted, or for another puzzle (hash collision) */
+  ENTRY_OK,
+} cache_entry;
+
+/** FNV-1a hash of the puzzle, independent of the piece orientations */
+static uint64_t _game_hash(cgame g) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  uint32_t header[3] = {game_nb_rows(g), game_nb_cols(g), game_is_wrapping(g)};
+  for (uint k = 0; k < 3; k++)
+    for (uint b = 0; b < 4; b++) {
+      h ^= (header[k] >> (8 * b)) & 0xFF;
+      h *= 0x100000001b3ULL;
+    }
+  for (uint i = 0; i < game_nb_rows(g); i++)
+    for (uint j = 0; j < game_nb_cols(g); j++) {
+      h ^= game_get_piece_shape(g, i, j);
+      h *= 0x100000001b3ULL;
+    }
+  return h;
+}
+
+/** build the path of a cache entry */
+static void _cache_path(char* path, size_t size, const char* dir, cgame g, const char* ext) {
+  snprintf(path, size, "%s/%016llx.%s", dir, (unsigned long long)_game_hash(g), ext);
+}
+
+/** create the cache directory if needed */
+static bool _cache_mkdir(const char* dir) {
+  if (mkdir(dir, 0755) == 0 || errno == EEXIST) return true;
+  fprintf(stderr, "Warning: cannot create cache directory %s\n", dir);
+  return false;
+}
+
+/** write a file atomically: the content goes to a temporary file that is
+ * renamed afterwards, so readers never see a truncated entry */
+static void _cache_commit(const char* tmp, const char* path) {
+  if (rename(tmp, path) != 0) {
+    fprintf(stderr, "Warning: cannot write cache entry %s\n", path);
+    remove(tmp);
+  }
+}
+
+/** look for the solution of g in the cache, and copy its orientations into g */
+static cache_entry _cache_get_solution(const char* dir, game g) {
+  char path[1024];
+  _cache_path(path, sizeof(path), dir, g, "sol");
+  if (access(path, F_OK) != 0) return ENTRY_MISSING;
+  game s = game_load(path);
+  if (s == NULL) return ENTRY_INVALID;
+  // guard against hash collisions and corrupted entries
+  bool ok = game_equal(g, s, true) && game_won(s);
+  if (ok)
+    for (uint i = 0; i < game_nb_rows(g); i++)
+      for (uint j = 0; j < game_nb_cols(g); j++) game_set_piece_orientation(g, i, j, game_get_piece_orientation(s, i, j));
+  game_delete(s);
+  return ok ? ENTRY_OK : ENTRY_INVALID;
+}
+
+static void _cache_put_solution(const char* dir, cgame g) {
+  if (!_cache_mkdir(dir)) return;
+  char path[1024];
+  _cache_path(path, sizeof(path), dir, g, "sol");
+  // game_save writes a temporary file and renames it, like _cache_commit
+  if (!game_save(g, path)) fprintf(stderr, "Warning: cannot write cache entry %s\n", path);
+}
+
+/** write the puzzle in a ".nb" entry: size, wrapping option, then one digit per shape */
+static void _cache_write_key(FILE* f, cgame g) {
+  fprintf(f, "%u %u %d\n", game_nb_rows(g), game_nb_cols(g), game_is_wrapping(g));
+  for (uint i = 0; i < game_nb_rows(g); i++)
+    for (uint j = 0; j < game_nb_cols(g); j++) fputc('0' + game_get_piece_shape(g, i, j), f);
+  fputc('\n', f);
+}
+
+/** read the puzzle of a ".nb" entry, and compare it with g */
+static bool _cache_check_key(FILE* f, cgame g) {
+  uint nb_rows, nb_cols, wrapping;
+  if (fscanf(f, "%u %u %u ", &nb_rows, &nb_cols, &wrapping) != 3) return false;
+  if (nb_rows != game_nb_rows(g) || nb_cols != game_nb_cols(g) || wrapping != game_is_wrapping(g)) return false;
+  for (uint i = 0; i < nb_rows; i++)
+    for (uint j = 0; j < nb_cols; j++)
+      if (fgetc(f) != '0' + (int)game_get_piece_shape(g, i, j)) return false;
+  return true;
+}
+
+static cache_entry _cache_get_count(const char* dir, cgame g, uint* nb_sol) {
+  char path[1024];
+  _cache_path(path, sizeof(path), dir, g, "nb");
+  FILE* f = fopen(path, "r");
+  if (!f) return ENTRY_MISSING;
+  bool ok = _cache_check_key(f, g) && fscanf(f, "%u", nb_sol) == 1;
+  fclose(f);
+  return ok ? ENTRY_OK : ENTRY_INVALID;
+}
+
+static void _cache_put_count(const char* dir, cgame g, uint nb_sol) {
+  if (!_cache_mkdir(dir)) return;
+  char path[1024], tmp[1100];
+  _cache_path(path, sizeof(path), dir, g, "nb");
+  // unique temporary file, since the batch workers may write the same entry
+  snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+  int fd = mkstemp(tmp);
+  FILE* f = (fd >= 0 && fchmod(fd, 0644) == 0) ? fdopen(fd, "w") : NULL;
+  if (!f) {
+    if (fd >= 0) {
+      close(fd);
+      remove(tmp);
+    }
+    fprintf(stderr, "Warning: cannot write cache entry %s\n", path);
+    return;
+  }
+  _cache_write_key(f, g);
+  fprintf(f, "%u\n", nb_sol);
+  if (fclose(f) != 0) {
+    remove(tmp);
+    return;
+  }
+  _cache_commit(tmp, path);
+}
+
+/** remove a cache entry that the solver contradicts */
+static void _cache_remove(const char* dir, cgame g, const char* ext) {
+  char path[1024];
+  _cache_path(path, sizeof(path), dir, g, ext);
+  if (remove(path) != 0) fprintf(stderr, "Warning: cannot remove cache entry %s\n", path);
+}
+
+/* ************************************************************************** */
+/*                                   PACKS                                    */
+/* ************************************************************************** */
+
+/** apply the option to every game of a pack: with -s, the output is a pack
+ * holding the games and their solutions, otherwise it holds one result per
+ * line (the cache is not used) */
+static int _solve_pack(char* option, char* input, char* output) {
+  pack p = pack_open(input);
+  if (p == NULL) {
+    fprintf(stderr, "%s: invalid pack\n", input);
+    exit(EXIT_FAILURE);
+  }
+  bool solve = (strcmp(option, "-s") == 0);
+  pack_writer w = (solve && output) ? pack_writer_open(output) : NULL;
+  FILE* f = (!solve && output) ? fopen(output, "w") : NULL;
+  if (output && !w && !f) {
+    fprintf(stderr, "Could not open file %s\n", output);
+    exit(EXIT_FAILURE);
+  }
+
+  double start = _now();
+  uint nb_solved = 0, n = pack_count(p);
+  for (uint k = 0; k < n; k++) {
+    game g = pack_get(p, k);
+    if (g == NULL) {
+      fprintf(stderr, "Warning: game %u of %s is corrupted\n", k, input);
+      continue;
+    }
+    if (solve) {
+      game s = game_copy(g);
+      bool res = game_solve(s);
+      if (res) nb_solved++;
+      if (w && !pack_writer_add(w, g, res ? s : NULL)) {
+        fprintf(stderr, "Could not write %s\n", output);
+        exit(EXIT_FAILURE);
+      }
+      game_delete(s);
+    } else if (strcmp(option, "-c") == 0) {
+      uint nb_sol = game_nb_solutions(g);
+      printf("%u\n", nb_sol);
+      if (f) fprintf(f, "%u\n", nb_sol);
+    } else if (strcmp(option, "-g") == 0) {
+      game_stats stats;
+      game_grade(g, &stats);
+      printf("%.2f\n", stats.difficulty);
+      if (f) fprintf(f, "%.2f\n", stats.difficulty);
+    }
+    game_delete(g);
+  }
+  double time_spent = _now() - start;
+  if (solve) printf("%u/%u parties résolues\n", nb_solved, n);
+  printf("Temps d'exécution : %.5f secondes\n", time_spent);
+  pack_close(p);
+  if (f) fclose(f);
+  if (w && !pack_writer_close(w)) {
+    fprintf(stderr, "Could not write %s\n", output);
+    exit(EXIT_FAILURE);
+  }
+  return EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+/*                                 BATCH MODE                                 */
+/* ************************************************************************** */
+
+/* In batch mode, the worker threads take the puzzles of the list one after the
+ * other, and the main thread prints the results in the order of the list, as
+ * soon as they are known. The cache is not used. */
+
+typedef struct {
+  char* input;      /* puzzle file */
+  bool done;        /* set by the worker, under the lock */
+  char error[256];  /* empty if the puzzle is processed */
+  bool solved;      /* -s: a solution is found */
+  uint nb_sol;      /* -c: number of solutions */
+  game_stats stats; /* -s and -g: solver statistics */
+  double time;      /* wall-clock time of the solver, in seconds */
+} batch_item;
+
+typedef struct {
+  char* option;
+  char* outdir; /* -s: directory of the solutions, or NULL */
+  bool binary;
+  batch_item* items;
+  uint count;
+  uint next; /* next item to process */
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+} batch;
+
+/** read the list of puzzles, one file per line, skipping the empty lines */
+static batch_item* _batch_read_list(char* filename, uint* count) {
+  FILE* f = fopen(filename, "r");
+  if (f == NULL) {
+    fprintf(stderr, "Could not open file %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  batch_item* items = NULL;
+  uint n = 0, capacity = 0;
+  char* line = NULL;
+  size_t line_size = 0;
+  ssize_t len;
+  while ((len = getline(&line, &line_size, f)) >= 0) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+    if (len == 0) continue;
+    if (n == capacity) {
+      capacity = capacity ? 2 * capacity : 64;
+      items = realloc(items, capacity * sizeof(batch_item));
+      assert(items);
+    }
+    items[n] = (batch_item){.input = strdup(line)};
+    assert(items[n].input);
+    n++;
+  }
+  free(line);
+  fclose(f);
+  *count = n;
+  return items;
+}
+
+/** file name of a puzzle, without its directory */
+static const char* _batch_name(const char* input) {
+  const char* name = strrchr(input, '/');
+  return name ? name + 1 : input;
+}
+
+/** path of the solution of a puzzle: its file name, in the output directory */
+static void _batch_output_path(char* path, size_t size, const batch* b, const char* input) {
+  snprintf(path, size, "%s/%s.%s", b->outdir, _batch_name(input), b->binary ? "bin" : "sol");
+}
+
+static int _compare_names(const void* a, const void* b) {
+  return strcmp(_batch_name(*(char* const*)a), _batch_name(*(char* const*)b));
+}
+
+/** check that no two puzzles of the list share a file name, whose solutions
+ * would overwrite each other in the output directory */
+static void _batch_check_outputs(const batch* b) {
+  char** inputs = malloc(b->count * sizeof(char*));
+  assert(inputs || b->count == 0);
+  for (uint k = 0; k < b->count; k++) inputs[k] = b->items[k].input;
+  qsort(inputs, b->count, sizeof(char*), _compare_names);
+  for (uint k = 1; k < b->count; k++)
+    if (_compare_names(&inputs[k - 1], &inputs[k]) == 0) {
+      fprintf(stderr, "Error: %s and %s would have the same solution file in %s\n", inputs[k - 1], inputs[k],
+              b->outdir);
+      exit(EXIT_FAILURE);
+    }
+  free(inputs);
+}
+
+static void _batch_process(batch* b, batch_item* it) {
+  load_error err;
+  game g = game_load_ext(it->input, &err);
+  if (g == NULL) {
+    if (err.status == LOAD_ERR_OPEN)
+      snprintf(it->error, sizeof(it->error), "%s", game_load_error_message(err.status));
+    else
+      snprintf(it->error, sizeof(it->error), "%u:%u: %s", err.line, err.col, game_load_error_message(err.status));
+    return;
+  }
+  double start = _now();
+  if (strcmp(b->option, "-s") == 0)
+    it->solved = game_solve_ext(g, &it->stats);
+  else if (strcmp(b->option, "-c") == 0)
+    it->nb_sol = game_nb_solutions_ext(g, 0, &it->stats);
+  else
+    game_grade(g, &it->stats);
+  it->time = _now() - start;
+  if (it->solved && b->outdir) {
+    char path[4096];
+    _batch_output_path(path, sizeof(path), b, it->input);
+    if (!(b->binary ? game_save_binary(g, path) : game_save(g, path)))
+      snprintf(it->error, sizeof(it->error), "cannot save the solution");
+  }
+  game_delete(g);
+}
+
+static void* _batch_worker(void* arg) {
+  batch* b = arg;
+  while (true) {
+    pthread_mutex_lock(&b->lock);
+    uint k = b->next < b->count ? b->next++ : b->count;
+    pthread_mutex_unlock(&b->lock);
+    if (k == b->count) return NULL;
+    _batch_process(b, &b->items[k]);
+    pthread_mutex_lock(&b->lock);
+    b->items[k].done = true;
+    pthread_cond_broadcast(&b->done);
+    pthread_mutex_unlock(&b->lock);
+  }
+}
+
+/** print a string as a JSON string */
+static void _print_json_string(const char* s) {
+  putchar('"');
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      printf("\\%c", *s);
+    else if ((unsigned char)*s < 0x20)
+      printf("\\u%04x", *s);
+    else
+      putchar(*s);
+  }
+  putchar('"');
+}
+
+/** print a string as a CSV field, quoted if needed */
+static void _print_csv_string(const char* s) {
+  if (strpbrk(s, ",\"\r\n") == NULL) {
+    fputs(s, stdout);
+    return;
+  }
+  putchar('"');
+  for (; *s; s++) {
+    if (*s == '"') putchar('"');
+    putchar(*s);
+  }
+  putchar('"');
+}
+
+static void _batch_print(const batch* b, const batch_item* it, bool json) {
+  bool ok = it->error[0] == '\0';
+  const game_stats* st = &it->stats;
+  if (json) {
+    printf("{\"file\":");
+    _print_json_string(it->input);
+    printf(",\"status\":\"%s\"", ok ? "ok" : "error");
+    if (!ok) {
+      printf(",\"error\":");
+      _print_json_string(it->error);
+    }
+    printf(",\"seconds\":%.6f", it->time);
+    if (ok && strcmp(b->option, "-s") == 0) printf(",\"solved\":%s", it->solved ? "true" : "false");
+    if (ok && strcmp(b->option, "-c") == 0) printf(",\"nb_solutions\":%u", it->nb_sol);
+    if (ok && strcmp(b->option, "-g") == 0)
+      printf(",\"difficulty\":%.2f,\"nb_solutions\":%u", st->difficulty, st->nb_solutions);
+    if (ok)
+      printf(",\"squares\":%u,\"propagated\":%u,\"branches\":%u,\"max_depth\":%u,\"backtracks\":%u,\"nodes\":%u",
+             st->nb_squares, st->nb_propagated, st->nb_branches, st->max_depth, st->nb_backtracks, st->nb_nodes);
+    printf("}\n");
+  } else {
+    _print_csv_string(it->input);
+    printf(",%s,%.6f,", ok ? "ok" : "error", it->time);
+    if (!ok)
+      _print_csv_string(it->error);
+    else if (strcmp(b->option, "-s") == 0)
+      printf("%s", it->solved ? "solved" : "unsolved");
+    else if (strcmp(b->option, "-c") == 0)
+      printf("%u", it->nb_sol);
+    else
+      printf("%.2f", st->difficulty);
+    if (ok)
+      printf(",%u,%u,%u,%u,%u,%u\n", st->nb_squares, st->nb_propagated, st->nb_branches, st->max_depth,
+             st->nb_backtracks, st->nb_nodes);
+    else
+      printf(",,,,,,\n");
+  }
+}
+
+/** apply the option to every puzzle of the list, with nb_jobs threads */
+static int _solve_batch(char* option, char* list, char* outdir, bool binary, uint nb_jobs, bool json) {
+  batch b = {.option = option, .outdir = outdir, .binary = binary};
+  b.items = _batch_read_list(list, &b.count);
+  if (outdir && strcmp(option, "-s") == 0 && mkdir(outdir, 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Could not create directory %s\n", outdir);
+    exit(EXIT_FAILURE);
+  }
+  if (strcmp(option, "-s") != 0) b.outdir = NULL;
+  if (b.outdir) _batch_check_outputs(&b);
+  if (nb_jobs > b.count) nb_jobs = b.count ? b.count : 1;
+  pthread_mutex_init(&b.lock, NULL);
+  pthread_cond_init(&b.done, NULL);
+  pthread_t* threads = malloc(nb_jobs * sizeof(pthread_t));
+  assert(threads);
+
+  double start = _now();
+  for (uint t = 0; t < nb_jobs; t++)
+    if (pthread_create(&threads[t], NULL, _batch_worker, &b) != 0) {
+      fprintf(stderr, "Error: Cannot create thread.\n");
+      exit(EXIT_FAILURE);
+    }
+  if (!json) printf("file,status,seconds,result,squares,propagated,branches,max_depth,backtracks,nodes\n");
+  uint nb_errors = 0;
+  for (uint k = 0; k < b.count; k++) {
+    pthread_mutex_lock(&b.lock);
+    while (!b.items[k].done) pthread_cond_wait(&b.done, &b.lock);
+    pthread_mutex_unlock(&b.lock);
+    _batch_print(&b, &b.items[k], json);
+    if (b.items[k].error[0]) nb_errors++;
+  }
+  for (uint t = 0; t < nb_jobs; t++) pthread_join(threads[t], NULL);
+  double elapsed = _now() - start;
+  fprintf(stderr, "%u puzzles (%u errors) in %.3f seconds with %u threads.\n", b.count, nb_errors, elapsed, nb_jobs);
+
+  pthread_cond_destroy(&b.done);
+  pthread_mutex_destroy(&b.lock);
+  free(threads);
+  for (uint k = 0; k < b.count; k++) free(b.items[k].input);
+  free(b.items);
+  return nb_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* ************************************************************************** */
+
 void usage(char* cmd) {
-  printf("Usage: %s<option> <input> [<output>]\n", cmd);
+  printf("Usage: %s [--cache <dir>] [--no-cache | --verify-cache] [--binary] <option> <input> [<output>]\n", cmd);
+  printf("       %s --batch <list> [--jobs <n>] [--json] [--binary] <option> [<output_dir>]\n", cmd);
   printf("Example: %s -s game.txt res.txt\n", cmd);
+  printf("Options: -s (solve), -c (count the solutions), -g (grade the difficulty)\n");
+  printf("The cache directory can also be set with the %s environment variable.\n", CACHE_ENV);
+  printf("With --binary, the solution is saved in the binary format.\n");
+  printf("The input can also be a pack: then every game of the pack is processed.\n");
+  printf("With --batch, every file of the list (one per line) is processed by a pool of threads, and the\n");
+  printf("solutions are saved in the output directory, so the files must have different names. One CSV\n");
+  printf("line (or JSON object), with the solver statistics, is printed per file.\n");
 }
 
 int main(int argc, char* argv[]) {
-  if (argc < 3 || argc > 4) {
+  char* cache_dir = getenv(CACHE_ENV);
+  cache_mode mode = CACHE_USE;
+  bool binary = false, json = false;
+  char* batch_list = NULL;
+  long nb_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+  // flags come first
+  int arg = 1;
+  while (arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+    if (strcmp(argv[arg], "--cache") == 0 && arg + 1 < argc) {
+      cache_dir = argv[++arg];
+    } else if (strcmp(argv[arg], "--no-cache") == 0) {
+      mode = CACHE_BYPASS;
+    } else if (strcmp(argv[arg], "--verify-cache") == 0) {
+      mode = CACHE_VERIFY;
+    } else if (strcmp(argv[arg], "--binary") == 0) {
+      binary = true;
+    } else if (strcmp(argv[arg], "--batch") == 0 && arg + 1 < argc) {
+      batch_list = argv[++arg];
+    } else if (strcmp(argv[arg], "--jobs") == 0 && arg + 1 < argc) {
+      nb_jobs = strtol(argv[++arg], NULL, 10);
+    } else if (strcmp(argv[arg], "--json") == 0) {
+      json = true;
+    } else {
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+    arg++;
+  }
+  if (cache_dir == NULL || cache_dir[0] == '\0') mode = CACHE_BYPASS;
+  if (nb_jobs < 1) nb_jobs = 1;
+
+  if (batch_list) {
+    if (argc - arg < 1 || argc - arg > 2 ||
+        (strcmp(argv[arg], "-s") != 0 && strcmp(argv[arg], "-c") != 0 && strcmp(argv[arg], "-g") != 0)) {
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+    return _solve_batch(argv[arg], batch_list, argc - arg == 2 ? argv[arg + 1] : NULL, binary, nb_jobs, json);
+  }
+
+  if (argc - arg < 2 || argc - arg > 3) {
     usage(argv[0]);
     exit(EXIT_FAILURE);
   }
-  char* option = argv[1];
-  char* input = argv[2];
+  char* option = argv[arg];
+  char* input = argv[arg + 1];
   char* output = NULL;
-  if (argc == 4) {
-    output = argv[3];
+  if (argc - arg == 3) {
+    output = argv[arg + 2];
+  }
+  if (pack_is_pack(input)) return _solve_pack(option, input, output);
+
+  load_error err;
+  game g = game_load_ext(input, &err);
+  if (g == NULL) {
+    fprintf(stderr, "%s:%u:%u: %s\n", input, err.line, err.col, game_load_error_message(err.status));
+    exit(EXIT_FAILURE);
   }
-  game g = game_load(input);
 
   if (strcmp(option, "-s") == 0) {
-    clock_t start = clock();
-    bool res_g = game_solve(g);
-    clock_t end = clock();
-    double time_spent = (double)(end - start) / CLOCKS_PER_SEC;
-    printf("Temps d'exécution : %.5f secondes\n", time_spent);
-    if (res_g && output) {
-      game_save(g, output);
+    double start = _now();
+    bool res_g = false;
+    bool hit = (mode == CACHE_USE) && _cache_get_solution(cache_dir, g) == ENTRY_OK;
+    if (hit) {
+      res_g = true;
+    } else {
+      cache_entry entry = ENTRY_MISSING;
+      if (mode == CACHE_VERIFY) {
+        game cached = game_copy(g);
+        entry = _cache_get_solution(cache_dir, cached);
+        game_delete(cached);
+      }
+      res_g = game_solve(g);
+      if (entry == ENTRY_INVALID)
+        fprintf(stderr, "Warning: invalid cache entry, %s it\n", res_g ? "rewriting" : "removing");
+      else if (entry == ENTRY_OK && !res_g)
+        fprintf(stderr, "Warning: cache entry solves a game the solver cannot solve, removing it\n");
+      if (res_g && mode != CACHE_BYPASS)
+        _cache_put_solution(cache_dir, g);
+      else if (!res_g && entry != ENTRY_MISSING)
+        _cache_remove(cache_dir, g, "sol");
+    }
+    double time_spent = _now() - start;
+    printf(res_g ? "Une solution a été trouvée !\n" : "Aucune solution trouvée.\n");
+    printf("Temps d'exécution : %.5f secondes%s\n", time_spent, hit ? " (cache)" : "");
+    if (res_g && output && !(binary ? game_save_binary(g, output) : game_save(g, output))) {
+      fprintf(stderr, "Could not save the solution to %s\n", output);
+      exit(EXIT_FAILURE);
     }
     if (!res_g) {
       exit(EXIT_FAILURE);
@@ -41,12 +589,45 @@ int main(int argc, char* argv[]) {
     game_print(g);
   }
 
-  if (strcmp(option, "-c") == 0) {
-    clock_t start = clock();
-    int nb_sol = game_nb_solutions(g);
-    clock_t end = clock();
-    double time_spent = (double)(end - start) / CLOCKS_PER_SEC;
+  if (strcmp(option, "-g") == 0) {
+    double start = _now();
+    game_stats stats;
+    game_grade(g, &stats);
+    double time_spent = _now() - start;
     printf("Temps d'exécution : %.5f secondes\n", time_spent);
+    printf("Pièces à orienter : %u\n", stats.nb_squares);
+    printf("Fixées par propagation : %u\n", stats.nb_propagated);
+    printf("Branchements : %u (profondeur max %u)\n", stats.nb_branches, stats.max_depth);
+    printf("Retours arrière : %u\n", stats.nb_backtracks);
+    printf("Solutions : %s\n", stats.nb_solutions == 0 ? "0" : stats.nb_solutions == 1 ? "1" : "2+");
+    if (output) {
+      FILE* f = fopen(output, "w");
+      if (!f) {
+        fprintf(stderr, "Could not open file");
+        exit(EXIT_FAILURE);
+      }
+      fprintf(f, "%.2f\n", stats.difficulty);
+      fclose(f);
+    }
+    printf("%.2f\n", stats.difficulty);
+  }
+
+  if (strcmp(option, "-c") == 0) {
+    double start = _now();
+    uint nb_sol = 0;
+    bool hit = (mode == CACHE_USE) && _cache_get_count(cache_dir, g, &nb_sol) == ENTRY_OK;
+    if (!hit) {
+      nb_sol = game_nb_solutions(g);
+      uint cached_sol;
+      cache_entry entry = (mode == CACHE_VERIFY) ? _cache_get_count(cache_dir, g, &cached_sol) : ENTRY_MISSING;
+      if (entry == ENTRY_INVALID)
+        fprintf(stderr, "Warning: invalid cache entry, rewriting it\n");
+      else if (entry == ENTRY_OK && cached_sol != nb_sol)
+        fprintf(stderr, "Warning: cache entry disagrees with the solver (%u != %u), rewriting it\n", cached_sol, nb_sol);
+      if (mode != CACHE_BYPASS) _cache_put_count(cache_dir, g, nb_sol);
+    }
+    double time_spent = _now() - start;
+    printf("Temps d'exécution : %.5f secondes%s\n", time_spent, hit ? " (cache)" : "");
     if (output) {
       FILE* f = fopen(output, "w");
       if (!f) {
@@ -58,4 +639,5 @@ int main(int argc, char* argv[]) {
     }
     printf("%d\n", nb_sol);
   }
-}
\ No newline at end of file
+  game_delete(g);
+}
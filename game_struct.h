@@ -8,6 +8,7 @@
 #define __GAME_STRUCT_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "game.h"
 #include "game_ext.h"
@@ -17,11 +18,16 @@
 /*                             DATA TYPES                                     */
 /* ************************************************************************** */
 
+/* shapes and orientations are stored on a byte each, instead of the size of
+ * an enum, to keep large grids small */
 typedef struct square_s {
-  shape s;     /**< piece shape */
-  direction o; /**< piece orientation */
+  unsigned char s; /**< piece shape */
+  unsigned char o; /**< piece orientation */
 } square;
 
+/** journal of a game, see game_journal.c */
+typedef struct journal_s journal;
+
 /**
  * @brief Game structure.
  * @details This is an opaque data type.
@@ -33,6 +39,9 @@ struct game_s {
   bool wrapping;     /**< the wrapping option */
   queue* undo_stack; /**< stack to undo moves */
   queue* redo_stack; /**< stack to redo moves */
+  void* map;         /**< mapped grid file holding the squares, or NULL */
+  size_t map_size;   /**< size of the mapping */
+  journal* journal;  /**< journal recording the moves, or NULL */
 };
 
 /* ************************************************************************** */
@@ -4,8 +4,11 @@
 #include <string.h>
 
 #include "game.h"
+#include "game_alloc.h"
 #include "game_aux.h"
 #include "game_ext.h"
+#include "game_journal.h"
+#include "game_pack.h"
 #include "game_struct.h"
 #include "game_tools.h"
 
@@ -358,7 +361,8 @@ void test_game_save() {
   direction dir[] = {NORTH, EAST, SOUTH, WEST, EAST, SOUTH};
   game g = game_new_ext(3, 2, shapes, dir, false);
   assert(g != NULL);
-  game_save(g, filename);
+  bool ok = game_save(g, filename);
+  assert(ok);
   FILE* f = fopen(filename, "r");
   assert(f != NULL);
   int nb_rows, nb_cols, wrapping;
@@ -386,7 +390,8 @@ void test_game_save() {
   direction dir2[] = {SOUTH, WEST, SOUTH, NORTH};
   game g2 = game_new_ext(2, 2, shapes2, dir2, true);
   assert(g2 != NULL);
-  game_save(g2, filename2);
+  ok = game_save(g2, filename2);
+  assert(ok);
   FILE* f2 = fopen(filename2, "r");
   assert(f2 != NULL);
   char shape, direction;
@@ -430,6 +435,732 @@ void test_game_is_wrapping() {
   printf("test_game_is_wrapping passed!\n");
 }
 
+void test_game_random() {
+  uint sizes[][2] = {{1, 2}, {2, 1}, {2, 2}, {3, 1}, {5, 5}, {4, 7}, {70, 130}};
+  for (uint k = 0; k < 7; k++) {
+    uint nb_rows = sizes[k][0], nb_cols = sizes[k][1];
+    for (int wrapping = 0; wrapping < 2; wrapping++) {
+      uint nb_empty = (nb_rows * nb_cols - 2) / 3;
+      game g = game_random(nb_rows, nb_cols, wrapping, nb_empty, 0);
+      assert(g != NULL);
+      assert(game_nb_rows(g) == nb_rows && game_nb_cols(g) == nb_cols);
+      assert(game_is_wrapping(g) == wrapping);
+      assert(game_won(g));
+      uint count = 0;
+      for (uint i = 0; i < nb_rows; i++)
+        for (uint j = 0; j < nb_cols; j++)
+          if (game_get_piece_shape(g, i, j) == EMPTY) count++;
+      assert(count == nb_empty);
+      game_delete(g);
+    }
+  }
+  // the tree has no block structure: many edges cross any column border
+  game big = game_random(256, 256, false, 0, 0);
+  assert(big != NULL);
+  uint nb_crossing = 0;
+  for (uint i = 0; i < 256; i++)
+    if (game_has_half_edge(big, i, 63, EAST)) nb_crossing++;
+  assert(nb_crossing >= 64);
+  game_delete(big);
+  // extra edges, as many as possible
+  uint extras[][5] = {{5, 5, 0, 0, 4}, {6, 4, 1, 3, 10}, {2, 2, 0, 0, 4}};
+  uint expected[] = {4, 10, 1};
+  for (uint k = 0; k < 3; k++) {
+    game g = game_random(extras[k][0], extras[k][1], extras[k][2], extras[k][3], extras[k][4]);
+    assert(g != NULL);
+    assert(game_won(g));
+    uint nb_half_edges = 0;
+    for (uint i = 0; i < game_nb_rows(g); i++)
+      for (uint j = 0; j < game_nb_cols(g); j++)
+        for (direction d = 0; d < NB_DIRS; d++)
+          if (game_has_half_edge(g, i, j, d)) nb_half_edges++;
+    uint nb_pieces = extras[k][0] * extras[k][1] - extras[k][3];
+    assert(nb_half_edges == 2 * (nb_pieces - 1 + expected[k]));
+    game_delete(g);
+  }
+  // the extra edges land anywhere on the board: with the same seed, the
+  // network is the same but for the extra edge, found in every quadrant
+  bool quadrants[4] = {false};
+  for (uint64_t seed = 0; seed < 40; seed++) {
+    prng r0, r1;
+    prng_seed(&r0, seed);
+    prng_seed(&r1, seed);
+    game g0 = game_random_ext(20, 20, false, 0, 0, &r0);
+    game g1 = game_random_ext(20, 20, false, 0, 1, &r1);
+    assert(g0 && g1);
+    uint nb_diffs = 0;
+    for (uint i = 0; i < 20; i++)
+      for (uint j = 0; j < 20; j++)
+        for (direction d = 0; d < NB_DIRS; d++)
+          if (game_has_half_edge(g0, i, j, d) != game_has_half_edge(g1, i, j, d)) {
+            quadrants[2 * (i / 10) + j / 10] = true;
+            nb_diffs++;
+          }
+    assert(nb_diffs == 2);  // the two half-edges of the extra edge
+    game_delete(g0);
+    game_delete(g1);
+  }
+  assert(quadrants[0] && quadrants[1] && quadrants[2] && quadrants[3]);
+  // invalid parameters
+  assert(game_random(1, 1, false, 0, 0) == NULL);
+  assert(game_random(3, 3, false, 8, 0) == NULL);
+  printf("test_game_random passed!\n");
+}
+
+void test_game_random_ext() {
+  // same seed, same game
+  prng r1, r2;
+  prng_seed(&r1, 2024);
+  prng_seed(&r2, 2024);
+  game g1 = game_random_ext(9, 7, true, 5, 3, &r1);
+  game g2 = game_random_ext(9, 7, true, 5, 3, &r2);
+  assert(g1 && g2);
+  assert(game_won(g1));
+  assert(game_equal(g1, g2, false));
+  game_delete(g1);
+  game_delete(g2);
+
+  // a jumped generator gives another stream
+  prng_seed(&r1, 2024);
+  prng_seed(&r2, 2024);
+  prng_jump(&r2);
+  g1 = game_random_ext(9, 7, true, 5, 3, &r1);
+  g2 = game_random_ext(9, 7, true, 5, 3, &r2);
+  assert(!game_equal(g1, g2, false));
+  game_delete(g1);
+  game_delete(g2);
+
+  // uniform draws stay in range
+  for (uint k = 0; k < 1000; k++) assert(prng_uniform(&r1, 7) < 7);
+  printf("test_game_random_ext passed!\n");
+}
+
+void test_game_save_file() {
+  char* filename = "game_save_file.txt";
+  game g = game_default_solution();
+  FILE* f = fopen(filename, "w");
+  assert(f != NULL);
+  game_save_file(g, f);
+  game_save_file(g, f);
+  fclose(f);
+  // the first game of the stream can be loaded back
+  game loaded_game = game_load(filename);
+  assert(game_equal(g, loaded_game, false));
+  game_delete(loaded_game);
+
+  // the second one follows it
+  f = fopen(filename, "r");
+  assert(f != NULL);
+  int nb_rows, nb_cols, wrapping, count = 0;
+  char shape, direction;
+  while (fscanf(f, "%d %d %d", &nb_rows, &nb_cols, &wrapping) == 3) {
+    assert(nb_rows == 5 && nb_cols == 5 && wrapping == 0);
+    for (int k = 0; k < nb_rows * nb_cols; k++) assert(fscanf(f, " %c%c", &shape, &direction) == 2);
+    count++;
+  }
+  assert(count == 2);
+  fclose(f);
+  game_delete(g);
+  printf("test_game_save_file passed!\n");
+}
+
+void test_game_nb_solutions_max() {
+  prng rng;
+  prng_seed(&rng, 42);
+  for (uint k = 0; k < 20; k++) {
+    game g = game_random_ext(3, 3, k % 2, 0, k % 3, &rng);
+    game_shuffle_orientation_ext(g, &rng);
+    uint nb_sol = game_nb_solutions(g);
+    assert(nb_sol >= 1);
+    assert(game_nb_solutions_max(g, 0) == nb_sol);
+    assert(game_nb_solutions_max(g, 1) == 1);
+    assert(game_nb_solutions_max(g, 2) == (nb_sol < 2 ? nb_sol : 2));
+    game_delete(g);
+  }
+  printf("test_game_nb_solutions_max passed!\n");
+}
+
+void test_game_grade() {
+  game g = game_default();
+  game_stats stats;
+  bool ok = game_grade(g, &stats);
+  assert(ok);
+  assert(stats.nb_solutions == game_nb_solutions_max(g, 2));
+  assert(stats.nb_propagated <= stats.nb_squares);
+  assert(stats.max_depth <= stats.nb_branches);
+  assert(stats.difficulty >= 0);
+  // solving stops at the first solution, with the same statistics
+  game_stats solve_stats;
+  ok = game_solve_ext(g, &solve_stats);
+  assert(ok && game_won(g));
+  assert(solve_stats.nb_solutions == 1 && solve_stats.nb_squares == stats.nb_squares);
+  assert(solve_stats.nb_propagated == stats.nb_propagated && solve_stats.nb_nodes <= stats.nb_nodes);
+  game_delete(g);
+
+  // a game without solution
+  shape shapes[] = {ENDPOINT, ENDPOINT, ENDPOINT, ENDPOINT};
+  direction dir[] = {NORTH, NORTH, NORTH, NORTH};
+  g = game_new_ext(2, 2, shapes, dir, false);
+  ok = game_grade(g, &stats);
+  assert(!ok);
+  assert(stats.nb_solutions == 0);
+  game_delete(g);
+
+  // the grade does not depend on the orientations
+  prng rng;
+  prng_seed(&rng, 31);
+  for (uint k = 0; k < 20; k++) {
+    game_stats stats2;
+    g = game_random_ext(6, 6, k % 2, 2, k % 4, &rng);
+    ok = game_grade(g, &stats);
+    assert(ok);
+    game_shuffle_orientation_ext(g, &rng);
+    ok = game_grade(g, &stats2);
+    assert(ok);
+    assert(stats.difficulty == stats2.difficulty && stats.nb_solutions == stats2.nb_solutions);
+    if (stats.nb_propagated == stats.nb_squares) assert(stats.difficulty == 0 && stats.nb_branches == 0);
+    game_delete(g);
+  }
+  printf("test_game_grade passed!\n");
+}
+
+/** progress callback: counts its calls, and stops the search after data[1] calls */
+static bool _count_progress(const game_stats* stats, void* data) {
+  uint* calls = data;
+  assert(stats->nb_nodes % SOLVER_PROGRESS_NODES == 1);
+  calls[0]++;
+  return calls[0] < calls[1];
+}
+
+void test_game_solve_progress() {
+  prng rng;
+  prng_seed(&rng, 49);
+  for (uint k = 0; k < 10; k++) {
+    game g = game_random_ext(12, 12, k % 2, 3, k % 4, &rng);
+    game_shuffle_orientation_ext(g, &rng);
+    // the search goes on: same solution as game_solve_ext
+    game g1 = game_copy(g), g2 = game_copy(g);
+    uint calls[2] = {0, 1000000};
+    game_stats stats1, stats2;
+    bool ok = game_solve_ext(g1, &stats1);
+    assert(ok && game_won(g1));
+    ok = game_solve_progress(g2, _count_progress, calls, &stats2);
+    assert(ok && game_equal(g1, g2, false));
+    assert(stats1.nb_nodes == stats2.nb_nodes);
+    assert(calls[0] == 1 + (stats2.nb_nodes - 1) / SOLVER_PROGRESS_NODES);
+    game_delete(g2);
+    // stopped at the first node: no solution, and the game is unchanged
+    g2 = game_copy(g);
+    calls[0] = 0, calls[1] = 1;
+    ok = game_solve_progress(g2, _count_progress, calls, NULL);
+    assert(!ok);
+    assert(calls[0] == 1 && game_equal(g, g2, false));
+    game_delete(g2);
+    game_delete(g1);
+    game_delete(g);
+  }
+  printf("test_game_solve_progress passed!\n");
+}
+
+void test_game_random_graded() {
+  prng rng;
+  prng_seed(&rng, 7);
+  game_stats stats;
+  // games solved by propagation alone
+  game g = game_random_graded(5, 5, false, 0, 0, 0, 0, 1000, &rng, &stats);
+  assert(g != NULL);
+  assert(stats.difficulty == 0 && stats.nb_branches == 0 && stats.nb_solutions == 1);
+  assert(stats.nb_propagated == stats.nb_squares);
+  game_delete(g);
+  // a harder band
+  g = game_random_graded(10, 10, true, 0, 3, 30, 1000, 1000, &rng, &stats);
+  assert(g != NULL && game_won(g));
+  assert(stats.difficulty >= 30 && stats.difficulty <= 1000);
+  game_delete(g);
+  // an empty band
+  game bad = game_random_graded(5, 5, false, 0, 0, -2, -1, 10, &rng, NULL);
+  assert(bad == NULL);
+  // invalid parameters
+  bad = game_random_graded(1, 1, false, 0, 0, 0, 1000, 10, &rng, NULL);
+  assert(bad == NULL);
+  printf("test_game_random_graded passed!\n");
+}
+
+void test_game_random_unique() {
+  prng rng;
+  prng_seed(&rng, 2025);
+  uint sizes[][5] = {{20, 20, 0, 0, 0}, {10, 12, 1, 5, 4}, {3, 3, 0, 1, 0}, {2, 6, 1, 0, 2}};
+  for (uint t = 0; t < 4; t++) {
+    uint nb_rows = sizes[t][0], nb_cols = sizes[t][1], nb_empty = sizes[t][3];
+    game g = game_random_unique(nb_rows, nb_cols, sizes[t][2], nb_empty, sizes[t][4], &rng);
+    assert(g != NULL);
+    assert(game_nb_rows(g) == nb_rows && game_nb_cols(g) == nb_cols);
+    assert(game_is_wrapping(g) == sizes[t][2]);
+    assert(game_won(g));
+    assert(game_nb_solutions_max(g, 2) == 1);
+    uint empty = 0;
+    for (uint i = 0; i < nb_rows; i++)
+      for (uint j = 0; j < nb_cols; j++)
+        if (game_get_piece_shape(g, i, j) == EMPTY) empty++;
+    assert(empty == nb_empty);
+    game_delete(g);
+  }
+  // invalid parameters
+  assert(game_random_unique(1, 1, false, 0, 0, &rng) == NULL);
+  printf("test_game_random_unique passed!\n");
+}
+
+void test_game_load_from_buffer() {
+  char buffer[] = "2 3 0\nCN NE SS\r\nTW XN EN\n";
+  shape shapes[] = {CORNER, ENDPOINT, SEGMENT, TEE, CROSS, EMPTY};
+  direction dirs[] = {NORTH, EAST, SOUTH, WEST, NORTH, NORTH};
+  game g = game_new_ext(2, 3, shapes, dirs, false);
+  load_error err;
+  game loaded_game = game_load_from_buffer(buffer, strlen(buffer), &err);
+  assert(loaded_game != NULL);
+  assert(err.status == LOAD_OK);
+  assert(game_equal(g, loaded_game, false));
+  game_delete(loaded_game);
+  // no trailing newline, and no null terminator
+  loaded_game = game_load_from_buffer(buffer, strlen(buffer) - 1, NULL);
+  assert(loaded_game != NULL && game_equal(g, loaded_game, false));
+  game_delete(loaded_game);
+  game_delete(g);
+
+  // errors, with their position
+  struct {
+    char* content;
+    load_status status;
+    uint line, col;
+  } cases[] = {
+      {"", LOAD_ERR_HEADER, 1, 1},
+      {"2 2\nCN CN\n", LOAD_ERR_HEADER, 2, 1},
+      {"2 2 3\nCN CN\nCN CN\n", LOAD_ERR_HEADER, 1, 6},
+      {"0 2 0\n", LOAD_ERR_HEADER, 1, 6},
+      {"2 2 0\nCN CN\nCN QN\n", LOAD_ERR_SHAPE, 3, 4},
+      {"2 2 0\nCN CZ\nCN CN\n", LOAD_ERR_ORIENTATION, 2, 5},
+      {"2 2 0\nCN CNN\nCN CN\n", LOAD_ERR_ORIENTATION, 2, 5},
+      {"2 2 0\nCN CN\nCN C", LOAD_ERR_TRUNCATED, 3, 5},
+      {"100000 100000 0\nCN\n", LOAD_ERR_HEADER, 1, 16},
+      {"1000 1000 0\nCN\n", LOAD_ERR_TRUNCATED, 3, 1},
+  };
+  for (uint k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+    err.status = LOAD_OK;
+    assert(game_load_from_buffer(cases[k].content, strlen(cases[k].content), &err) == NULL);
+    assert(err.status == cases[k].status);
+    assert(err.line == cases[k].line && err.col == cases[k].col);
+    assert(game_load_error_message(err.status) != NULL);
+  }
+
+  // missing file
+  assert(game_load_ext("no_such_file.txt", &err) == NULL);
+  assert(err.status == LOAD_ERR_OPEN);
+  assert(game_load("no_such_file.txt") == NULL);
+  printf("test_game_load_from_buffer passed!\n");
+}
+
+void test_game_save_to_buffer() {
+  prng rng;
+  prng_seed(&rng, 34);
+  game g = game_random_ext(7, 9, true, 3, 2, &rng);
+  game_shuffle_orientation_ext(g, &rng);
+  size_t size;
+  char* buf = game_save_to_buffer(g, &size);
+  assert(buf != NULL);
+  assert(size == strlen(buf));
+  assert(strncmp(buf, "7 9 1\n", 6) == 0);
+  assert(size == 6 + 7 * (9 * 3 + 1));
+  game loaded_game = game_load_from_buffer(buf, size, NULL);
+  assert(loaded_game && game_equal(g, loaded_game, false));
+  game_delete(loaded_game);
+
+  // the file holds the same content
+  char* filename = "game_save_to_buffer.txt";
+  bool ok = game_save(g, filename);
+  assert(ok);
+  FILE* f = fopen(filename, "r");
+  assert(f != NULL);
+  char* content = malloc(size + 2);
+  assert(content);
+  assert(fread(content, 1, size + 2, f) == size);
+  assert(memcmp(buf, content, size) == 0);
+  fclose(f);
+  free(content);
+  free(buf);
+
+  // saving in a missing directory fails, without leaving a file behind
+  ok = game_save(g, "no_such_dir/game.txt");
+  assert(!ok);
+  assert(fopen("no_such_dir/game.txt", "r") == NULL);
+  game_delete(g);
+  printf("test_game_save_to_buffer passed!\n");
+}
+
+void test_game_save_binary() {
+  prng rng;
+  prng_seed(&rng, 35);
+  game g = game_random_ext(6, 11, true, 4, 3, &rng);
+  game_shuffle_orientation_ext(g, &rng);
+  size_t size;
+  char* buf = game_save_binary_to_buffer(g, &size);
+  assert(buf != NULL);
+  assert(size == 20 + 6 * 11);
+  assert(memcmp(buf, "NETG", 4) == 0);
+  load_error err;
+  game loaded_game = game_load_from_buffer(buf, size, &err);
+  assert(loaded_game && err.status == LOAD_OK);
+  assert(game_equal(g, loaded_game, false));
+  game_delete(loaded_game);
+
+  // the format is detected when loading a file
+  char* filename = "game_save_binary.bin";
+  bool ok = game_save_binary(g, filename);
+  assert(ok);
+  loaded_game = game_load(filename);
+  assert(loaded_game && game_equal(g, loaded_game, false));
+  game_delete(loaded_game);
+
+  // errors
+  assert(game_load_from_buffer(buf, size - 1, &err) == NULL && err.status == LOAD_ERR_TRUNCATED);
+  assert(game_load_from_buffer(buf, 10, &err) == NULL && err.status == LOAD_ERR_HEADER);
+  buf[30] ^= 1;
+  assert(game_load_from_buffer(buf, size, &err) == NULL && err.status == LOAD_ERR_CHECKSUM);
+  buf[30] ^= 1;
+  buf[4] = 99;
+  assert(game_load_from_buffer(buf, size, &err) == NULL && err.status == LOAD_ERR_VERSION);
+  assert(err.line == 0 && err.col == 5);
+  free(buf);
+  game_delete(g);
+  printf("test_game_save_binary passed!\n");
+}
+
+void test_game_map_file() {
+  char* filename = "test_game_map_file.grid";
+  prng rng;
+  prng_seed(&rng, 37);
+  game g = game_random_ext(7, 9, true, 3, 2, &rng);
+  game_shuffle_orientation_ext(g, &rng);
+  bool ok = game_save_grid(g, filename);
+  assert(ok);
+  game loaded_game = game_load(filename);
+  assert(loaded_game && game_equal(g, loaded_game, false));
+  game_delete(loaded_game);
+
+  // the moves of a writable mapping are written to the file
+  game mapped = game_map_file(filename, true);
+  assert(mapped != NULL);
+  assert(game_equal(g, mapped, false) && game_is_wrapping(mapped));
+  game_play_move(mapped, 2, 3, 1);
+  game_play_move(g, 2, 3, 1);
+  game_undo(mapped);
+  game_redo(mapped);
+  game_delete(mapped);
+  mapped = game_map_file(filename, false);
+  assert(mapped && game_equal(g, mapped, false));
+
+  // a private mapping can be played, but is left unchanged on disk
+  ok = game_solve(mapped);
+  assert(ok);
+  assert(game_won(mapped));
+  game_delete(mapped);
+  loaded_game = game_load(filename);
+  assert(loaded_game && game_equal(g, loaded_game, false));
+  game_delete(loaded_game);
+
+  // errors
+  size_t size;
+  char* buf = game_save_grid_to_buffer(g, &size);
+  assert(size == 16 + 2 * 7 * 9 && memcmp(buf, "NETM", 4) == 0);
+  load_error err;
+  assert(game_load_from_buffer(buf, size - 1, &err) == NULL && err.status == LOAD_ERR_TRUNCATED);
+  buf[16] = NB_SHAPES;
+  assert(game_load_from_buffer(buf, size, &err) == NULL && err.status == LOAD_ERR_SHAPE);
+  assert(err.line == 0 && err.col == 17);
+  free(buf);
+  assert(game_map_file("does_not_exist.grid", false) == NULL);
+  ok = game_save(g, filename);
+  assert(ok);
+  assert(game_map_file(filename, false) == NULL);  // text file
+  game_delete(g);
+  printf("test_game_map_file passed!\n");
+}
+
+/** check that two games have the same squares and the same history */
+static void _check_same_history(game g1, game g2) {
+  assert(game_equal(g1, g2, false));
+  for (uint k = 0; k < 1000; k++) {
+    game_undo(g1);
+    game_undo(g2);
+    assert(game_equal(g1, g2, false));
+  }
+  for (uint k = 0; k < 1000; k++) {
+    game_redo(g1);
+    game_redo(g2);
+    assert(game_equal(g1, g2, false));
+  }
+}
+
+void test_game_journal() {
+  char* filename = "test_game_journal.journal";
+  prng rng;
+  prng_seed(&rng, 38);
+  game g = game_random_ext(8, 6, false, 2, 1, &rng);
+  game_shuffle_orientation_ext(g, &rng);
+  game_play_move(g, 1, 1, 1);
+  game_play_move(g, 2, 3, -1);
+  game_undo(g);
+  // the history played before the journal is part of the snapshot
+  bool ok = game_journal_start(g, filename);
+  assert(ok);
+  for (uint k = 0; k < 500; k++) {
+    uint r = prng_next(&rng) % 10;
+    if (r == 0)
+      game_undo(g);
+    else if (r == 1)
+      game_redo(g);
+    else
+      game_play_move(g, prng_next(&rng) % 8, prng_next(&rng) % 6, r % 3 - 1);
+  }
+  ok = game_journal_flush(g);
+  assert(ok);
+  load_error err;
+  game restored = game_journal_load(filename, &err);
+  assert(restored && err.status == LOAD_OK);
+  _check_same_history(g, restored);
+
+  // events, and restarting from the journal
+  game_shuffle_orientation_ext(g, &rng);
+  game_play_move(g, 0, 0, 2);
+  game_solve(g);
+  game_play_move(g, 7, 5, 1);
+  game_reset_orientation(g);
+  game_play_move(g, 4, 4, 3);
+  game_play_move(g, 4, 3, 1);
+  game_undo(g);
+  ok = game_journal_stop(g);
+  assert(ok);
+  game_delete(restored);
+  restored = game_journal_open(filename, &err);
+  assert(restored && err.status == LOAD_OK);
+  game_play_move(g, 5, 2, 1);
+  game_play_move(restored, 5, 2, 1);
+  game_delete(restored);
+  restored = game_journal_load(filename, NULL);
+  _check_same_history(g, restored);
+  game_delete(restored);
+
+  // a record cut short is dropped
+  FILE* f = fopen(filename, "ab");
+  assert(f && fputc(0x80, f) == 0x80 && fclose(f) == 0);
+  restored = game_journal_open(filename, &err);
+  assert(restored && err.status == LOAD_OK);
+  game_play_move(restored, 0, 1, 1);
+  game_play_move(g, 0, 1, 1);
+  game_delete(restored);
+  restored = game_journal_load(filename, NULL);
+  assert(restored && game_equal(g, restored, false));
+  game_delete(restored);
+
+  // errors
+  f = fopen(filename, "ab");
+  unsigned char record[] = {0x80, 0x7D};  // move to the square 1000 after the last one
+  assert(f && fwrite(record, 1, 2, f) == 2 && fclose(f) == 0);
+  assert(game_journal_load(filename, &err) == NULL && err.status == LOAD_ERR_RECORD);
+  assert(game_journal_load("does_not_exist.journal", &err) == NULL && err.status == LOAD_ERR_OPEN);
+  ok = game_save(g, filename);
+  assert(ok);
+  assert(game_journal_load(filename, &err) == NULL && err.status == LOAD_ERR_HEADER);
+
+  // a start that fails leaves the previous journal unchanged
+  ok = game_journal_start(g, "no_such_dir/test_game_journal.journal");
+  assert(!ok);
+  ok = game_journal_start(g, filename);
+  assert(ok);
+  game_play_move(g, 3, 3, 1);
+  ok = game_journal_stop(g);
+  assert(ok);
+  ok = game_journal_start(g, "no_such_dir/test_game_journal.journal");
+  assert(!ok);
+  restored = game_journal_load(filename, NULL);
+  assert(restored && game_equal(g, restored, false));
+  game_delete(restored);
+  game_delete(g);
+  printf("test_game_journal passed!\n");
+}
+
+void test_pack() {
+  char* filename = "test_pack.pack";
+  prng rng;
+  prng_seed(&rng, 36);
+  game games[50], solutions[50];
+  pack_writer w = pack_writer_open(filename);
+  assert(w != NULL);
+  bool ok = true;
+  for (uint k = 0; k < 50; k++) {
+    solutions[k] = game_random_ext(2 + k % 7, 3 + k % 5, k % 2, 0, k % 3, &rng);
+    games[k] = game_copy(solutions[k]);
+    game_shuffle_orientation_ext(games[k], &rng);
+    // only the even games have their solution stored
+    ok = pack_writer_add(w, games[k], (k % 2) ? NULL : solutions[k]);
+    assert(ok);
+  }
+  ok = pack_writer_close(w);
+  assert(ok);
+
+  assert(pack_is_pack(filename));
+  pack p = pack_open(filename);
+  assert(p != NULL);
+  assert(pack_count(p) == 50);
+  // random access, in any order
+  for (uint t = 0; t < 50; t++) {
+    uint k = (7 * t) % 50;
+    game g = pack_get(p, k);
+    assert(g && game_equal(g, games[k], false));
+    game_delete(g);
+    game s = pack_get_solution(p, k);
+    assert((k % 2) ? s == NULL : (s && game_equal(s, solutions[k], false)));
+    if (s) game_delete(s);
+  }
+  pack_close(p);
+  for (uint k = 0; k < 50; k++) {
+    game_delete(games[k]);
+    game_delete(solutions[k]);
+  }
+
+  // an empty pack
+  w = pack_writer_open(filename);
+  assert(w != NULL);
+  ok = pack_writer_close(w);
+  assert(ok);
+  p = pack_open(filename);
+  assert(p && pack_count(p) == 0);
+  pack_close(p);
+
+  // two writers of the same pack at once: each one has its own temporary file
+  game g = game_default();
+  pack_writer w1 = pack_writer_open(filename), w2 = pack_writer_open(filename);
+  assert(w1 && w2);
+  bool ok1 = pack_writer_add(w1, g, NULL), ok2 = pack_writer_add(w2, g, g);
+  assert(ok1 && ok2);
+  ok2 = pack_writer_add(w2, g, NULL);
+  assert(ok2);
+  ok1 = pack_writer_close(w1);
+  ok2 = pack_writer_close(w2);
+  assert(ok1 && ok2);
+  p = pack_open(filename);
+  assert(p && pack_count(p) == 2);  // the last one closed
+  pack_close(p);
+
+  // not a pack
+  ok = game_save(g, "test_pack.txt");
+  assert(ok);
+  assert(!pack_is_pack("test_pack.txt"));
+  assert(pack_open("test_pack.txt") == NULL);
+  assert(pack_open("no_such_file.pack") == NULL);
+  game_delete(g);
+  printf("test_pack passed!\n");
+}
+
+/* a custom allocator on top of malloc, counting its blocks */
+typedef struct {
+  uint nb_allocs, nb_frees;
+  size_t live_bytes;
+} test_arena;
+
+static void* _test_alloc(size_t size, void* data) {
+  test_arena* a = data;
+  a->nb_allocs++;
+  a->live_bytes += size;
+  return malloc(size);
+}
+
+static void _test_free(void* ptr, size_t size, void* data) {
+  test_arena* a = data;
+  a->nb_frees++;
+  a->live_bytes -= size;
+  free(ptr);
+}
+
+static void _assert_alloc_stats(alloc_subsystem s, uint nb_allocs, uint nb_frees, bool live) {
+  game_alloc_stats st;
+  game_get_alloc_stats(s, &st);
+  assert(st.nb_allocs == nb_allocs && st.nb_frees == nb_frees && (st.live_bytes > 0) == live);
+}
+
+void test_game_allocator() {
+  test_arena arena = {0};
+  game_allocator a = {_test_alloc, _test_free, &arena};
+  game_set_allocator(&a);
+
+  // a game, with its squares and its 2 history stacks
+  game g = game_default();
+  game_alloc_stats st;
+  game_get_alloc_stats(ALLOC_GAME, &st);
+  assert(st.nb_allocs == 2 && st.nb_frees == 0 && st.live_bytes == sizeof(struct game_s) + 25 * sizeof(square));
+  _assert_alloc_stats(ALLOC_QUEUE, 2, 0, true);
+  _assert_alloc_stats(ALLOC_HISTORY, 0, 0, false);
+
+  // a move pushes a move and a queue element, an undo moves them to the redo stack
+  game_reset_alloc_stats();
+  game_play_move(g, 0, 0, 1);
+  _assert_alloc_stats(ALLOC_HISTORY, 1, 0, true);
+  _assert_alloc_stats(ALLOC_QUEUE, 1, 0, true);
+  game_undo(g);
+  _assert_alloc_stats(ALLOC_HISTORY, 1, 0, true);
+  _assert_alloc_stats(ALLOC_QUEUE, 1, 0, true);
+
+  // once warmed up, playing, undoing, redoing and checking with buffers owned
+  // by the caller allocate nothing
+  bool visited[25];
+  uint fifo[25];
+  bool won = false;
+  game_reset_alloc_stats();
+  for (uint k = 0; k < 100; k++) {
+    game_play_move(g, k % 5, k / 5 % 5, 1);
+    game_undo(g);
+    game_redo(g);
+    won = game_is_well_paired(g) && game_is_connected_ext(g, visited, fifo);
+    game_undo(g);
+  }
+  assert(!won);
+  for (alloc_subsystem sub = 0; sub < NB_ALLOC_SUBSYSTEMS; sub++) {
+    game_get_alloc_stats(sub, &st);
+    assert(st.nb_allocs == 0 && st.nb_frees == 0);
+  }
+
+  // the checks, the solver and the saving release their temporary blocks
+  game_reset_alloc_stats();
+  game s = game_copy(g);
+  bool ok = game_solve(s);
+  assert(ok);
+  game_get_alloc_stats(ALLOC_SOLVER, &st);
+  assert(st.nb_allocs > 0 && st.nb_allocs == st.nb_frees && st.live_bytes == 0);
+  assert(game_won(s) && game_is_connected_ext(s, visited, fifo));
+  game_get_alloc_stats(ALLOC_CHECK, &st);
+  assert(st.nb_allocs > 0 && st.nb_allocs == st.nb_frees && st.live_bytes == 0);
+  ok = game_save(s, "test_game_allocator.txt");
+  assert(ok);
+  game_get_alloc_stats(ALLOC_IO, &st);
+  assert(st.nb_allocs == 1 && st.nb_frees == 1 && st.live_bytes == 0);
+  game_delete(s);
+
+  // everything is given back to the allocator
+  game_delete(g);
+  for (alloc_subsystem sub = 0; sub < NB_ALLOC_SUBSYSTEMS; sub++) {
+    game_get_alloc_stats(sub, &st);
+    assert(st.live_bytes == 0);
+  }
+  assert(arena.nb_allocs > 0 && arena.nb_allocs == arena.nb_frees && arena.live_bytes == 0);
+
+  // back to malloc
+  game_set_allocator(NULL);
+  g = game_default();
+  uint nb_allocs = arena.nb_allocs;
+  game_delete(g);
+  assert(arena.nb_allocs == nb_allocs);
+  printf("test_game_allocator passed!\n");
+}
+
 int main(int argc, char* argv[]) {
   if (argc < 2) {
     return EXIT_FAILURE;
@@ -470,6 +1201,51 @@ int main(int argc, char* argv[]) {
   } else if (strcmp(argv[1], "game_save") == 0) {
     test_game_save();
     return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_random") == 0) {
+    test_game_random();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_random_ext") == 0) {
+    test_game_random_ext();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_save_file") == 0) {
+    test_game_save_file();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_nb_solutions_max") == 0) {
+    test_game_nb_solutions_max();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_grade") == 0) {
+    test_game_grade();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_solve_progress") == 0) {
+    test_game_solve_progress();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_random_graded") == 0) {
+    test_game_random_graded();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_random_unique") == 0) {
+    test_game_random_unique();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_load_from_buffer") == 0) {
+    test_game_load_from_buffer();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_save_to_buffer") == 0) {
+    test_game_save_to_buffer();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_save_binary") == 0) {
+    test_game_save_binary();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_map_file") == 0) {
+    test_game_map_file();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_journal") == 0) {
+    test_game_journal();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "pack") == 0) {
+    test_pack();
+    return EXIT_SUCCESS;
+  } else if (strcmp(argv[1], "game_allocator") == 0) {
+    test_game_allocator();
+    return EXIT_SUCCESS;
   } else {
     return EXIT_FAILURE;
   }
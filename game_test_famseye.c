@@ -661,6 +661,25 @@ bool test_game_new_ext() {
   return true;
 }
 
+// Verification que shuffle avec une graine donnée est reproductible
+bool test_famseye_game_shuffle_orientation_ext() {
+  game g1 = game_default();
+  game g2 = game_default();
+  prng r1, r2;
+  prng_seed(&r1, 7);
+  prng_seed(&r2, 7);
+  game_shuffle_orientation_ext(g1, &r1);
+  game_shuffle_orientation_ext(g2, &r2);
+  bool ok = game_equal(g1, g2, false);
+  // les formes ne changent pas
+  game g = game_default();
+  ok = ok && game_equal(g, g1, true) && !game_equal(g, g1, false);
+  game_delete(g);
+  game_delete(g1);
+  game_delete(g2);
+  return ok;
+}
+
 void usage(int argc, char *argv[]) {
   fprintf(stderr, "Usage: %s <testname> [<...>]\n", argv[0]);
   exit(EXIT_FAILURE);
@@ -686,6 +705,8 @@ int main(int argc, char *argv[]) {
     ok = test_famseye_game_reset_orientation();
   } else if (strcmp("shuffle_orientation", argv[1]) == 0) {
     ok = test_famseye_game_shuffle_orientation();
+  } else if (strcmp("shuffle_orientation_ext", argv[1]) == 0) {
+    ok = test_famseye_game_shuffle_orientation_ext();
   } else if (strcmp("game_won", argv[1]) == 0) {
     ok = test_famseye_game_won();
   } else if (strcmp("game_is_connected", argv[1]) == 0) {
@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "game.h"
 #include "game_aux.h"
 #include "game_ext.h"
+#include "game_journal.h"
 #include "game_struct.h"
 #include "game_tools.h"
 
@@ -19,18 +21,47 @@ void help() {
 
 int main(int argc, char* argv[]) {
   game g = NULL;
+  // the moves may be recorded in a journal, given first
+  char* journal = NULL;
+  if (argc >= 3 && strcmp(argv[1], "--journal") == 0) {
+    journal = argv[2];
+    argc -= 2;
+    argv += 2;
+  }
   if (argc == 1) {
     g = game_default();
   } else if (argc == 2) {
-    g = game_load(argv[1]);
+    load_error err;
+    g = game_load_ext(argv[1], &err);
+    if (g == NULL) {
+      fprintf(stderr, "%s:%u:%u: %s\n", argv[1], err.line, err.col, game_load_error_message(err.status));
+      exit(EXIT_FAILURE);
+    }
   } else {
     fprintf(stderr, "Too many arguments\n");
     exit(EXIT_FAILURE);
   }
+  // resume the session recorded in the journal, if it exists
+  if (journal != NULL) {
+    load_error err;
+    game resumed = game_journal_open(journal, &err);
+    if (resumed != NULL) {
+      game_delete(g);
+      g = resumed;
+    } else if (err.status != LOAD_ERR_OPEN) {
+      fprintf(stderr, "%s:%u:%u: %s\n", journal, err.line, err.col, game_load_error_message(err.status));
+      exit(EXIT_FAILURE);
+    } else if (!game_journal_start(g, journal)) {
+      fprintf(stderr, "Cannot create the journal %s\n", journal);
+      exit(EXIT_FAILURE);
+    }
+  }
   char ptr;
   uint i, j;
   while (!game_won(g)) {
     game_print(g);
+    // the moves are played at the pace of the user, so record them right away
+    if (!game_journal_flush(g)) fprintf(stderr, "Cannot write the journal %s\n", journal);
     printf("Entrez une commande : ");
     scanf(" %c", &ptr);
 
@@ -55,7 +86,7 @@ int main(int argc, char* argv[]) {
       } else {
         printf("Entrez le nom du fichier pour la sauvegarde (50 letters max) : \n");
         if (scanf("%s", filename)) {
-          game_save(g, filename);
+          if (!game_save(g, filename)) fprintf(stderr, "Cannot save the game in %s\n", filename);
           free(filename);
         }
       }
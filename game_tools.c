@@ -1,11 +1,20 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "game_tools.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "assert.h"
 #include "game_aux.h"
+#include "game_private.h"
 #include "game_struct.h"
 #include "queue.h"
 // @copyright University of Bordeaux. All rights reserved, 2024.
@@ -33,383 +42,1156 @@ static uint _encode_shape(shape s, direction o) { return _code[s][o]; }
 
 /* ************************************************************************** */
 
-/** decode an integer code into a shape and an orientation */
-static bool _decode_shape(uint code, shape* s, direction* o) {
-  assert(code >= 0 && code < 16);
-  assert(s);
-  assert(o);
-  for (int i = 0; i < NB_SHAPES; i++)
-    for (int j = 0; j < NB_DIRS; j++)
-      if (code == _code[i][j]) {
-        *s = i;
-        *o = j;
-        return true;
+#define OPPOSITE_DIR(d) ((d + 2) % NB_DIRS)
+
+/* ************************************************************************** */
+
+/** shape and orientation of each letter, plus one (0 for invalid letters) */
+static const unsigned char _char2shape[256] = {['E'] = EMPTY + 1, ['N'] = ENDPOINT + 1, ['S'] = SEGMENT + 1,
+                                               ['C'] = CORNER + 1, ['T'] = TEE + 1,     ['X'] = CROSS + 1};
+static const unsigned char _char2dir[256] = {['N'] = NORTH + 1, ['E'] = EAST + 1, ['S'] = SOUTH + 1, ['W'] = WEST + 1};
+
+static const char* _load_messages[] = {
+    [LOAD_OK] = "no error",
+    [LOAD_ERR_OPEN] = "cannot open the file",
+    [LOAD_ERR_HEADER] = "invalid header",
+    [LOAD_ERR_SHAPE] = "invalid shape",
+    [LOAD_ERR_ORIENTATION] = "invalid orientation",
+    [LOAD_ERR_TRUNCATED] = "missing squares",
+    [LOAD_ERR_VERSION] = "unsupported binary format version",
+    [LOAD_ERR_CHECKSUM] = "checksum mismatch",
+    [LOAD_ERR_RECORD] = "invalid journal record",
+};
+
+typedef struct {
+  const char *p, *end;
+  const char* line_start;
+  uint line;
+} cursor;
+
+static void _skip_spaces(cursor* c) {
+  while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r' || *c->p == '\n')) {
+    if (*c->p == '\n') {
+      c->line++;
+      c->line_start = c->p + 1;
+    }
+    c->p++;
+  }
+}
+
+/** move to the end of the buffer, for errors reported there */
+static void _seek_end(cursor* c) {
+  for (; c->p < c->end; c->p++)
+    if (*c->p == '\n') {
+      c->line++;
+      c->line_start = c->p + 1;
+    }
+}
+
+static bool _is_space_or_end(const cursor* c, const char* p) {
+  return p == c->end || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n';
+}
+
+static bool _parse_uint(cursor* c, uint* value) {
+  _skip_spaces(c);
+  if (c->p == c->end || *c->p < '0' || *c->p > '9') return false;
+  uint64_t v = 0;
+  while (c->p < c->end && *c->p >= '0' && *c->p <= '9') {
+    v = 10 * v + (*c->p++ - '0');
+    if (v > UINT32_MAX) return false;
+  }
+  *value = v;
+  return _is_space_or_end(c, c->p);
+}
+
+static game _load_error(load_error* err, load_status status, const cursor* c, game g) {
+  if (err) {
+    err->status = status;
+    err->line = c->line;
+    err->col = c->p - c->line_start + 1;
+  }
+  if (g) game_delete(g);
+  return NULL;
+}
+
+static game _load_text(const char* buffer, size_t size, load_error* err) {
+  cursor c = {buffer, buffer + size, buffer, 1};
+  uint nb_rows, nb_cols, wrapping;
+  if (!_parse_uint(&c, &nb_rows) || !_parse_uint(&c, &nb_cols) || !_parse_uint(&c, &wrapping) || nb_rows == 0 ||
+      nb_cols == 0 || wrapping > 1 || (uint64_t)nb_rows * nb_cols > UINT32_MAX)
+    return _load_error(err, LOAD_ERR_HEADER, &c, NULL);
+  // each square takes at least 2 characters, so this also bounds the allocation
+  if ((uint64_t)nb_rows * nb_cols > (uint64_t)(c.end - c.p) / 2) {
+    _seek_end(&c);
+    return _load_error(err, LOAD_ERR_TRUNCATED, &c, NULL);
+  }
+
+  game g = game_new_empty_ext(nb_rows, nb_cols, wrapping);
+  square* sq = g->squares;
+  // the cursor is kept in local variables: the stores into the squares (bytes)
+  // could alias it, which would prevent the compiler from keeping it in registers
+  const char *p = c.p, *end = c.end, *line_start = c.line_start;
+  uint line = c.line;
+  for (uint k = 0; k < nb_rows * nb_cols; k++) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+      if (*p == '\n') {
+        line++;
+        line_start = p + 1;
       }
-  return false;
+      p++;
+    }
+    unsigned char s = (end - p >= 2) ? _char2shape[(unsigned char)p[0]] : 0;
+    unsigned char o = (end - p >= 2) ? _char2dir[(unsigned char)p[1]] : 0;
+    if (!s || !o || (end - p > 2 && p[2] != ' ' && p[2] != '\t' && p[2] != '\r' && p[2] != '\n')) {
+      c = (cursor){p, end, line_start, line};
+      if (end - p < 2) {
+        _seek_end(&c);
+        return _load_error(err, LOAD_ERR_TRUNCATED, &c, g);
+      }
+      if (!s) return _load_error(err, LOAD_ERR_SHAPE, &c, g);
+      c.p++;
+      return _load_error(err, LOAD_ERR_ORIENTATION, &c, g);
+    }
+    sq[k].s = s - 1;
+    sq[k].o = o - 1;
+    p += 2;
+  }
+  if (err) *err = (load_error){LOAD_OK, 0, 0};
+  return g;
 }
 
-/* ************************************************************************** */
+/* The binary format starts with a header of BINARY_HEADER_SIZE bytes, all the
+ * integers being stored in little-endian order:
+ *   0: magic "NETG"
+ *   4: version (16 bits)
+ *   6: wrapping (8 bits)
+ *   7: flags (8 bits, 0 for now)
+ *   8: number of rows (32 bits)
+ *  12: number of columns (32 bits)
+ *  16: FNV-1a checksum of the squares (32 bits)
+ * Then each square takes one byte, (shape << 2) | orientation, in row-major
+ * order. */
+
+#define BINARY_MAGIC "NETG"
+#define BINARY_VERSION 1
+#define BINARY_HEADER_SIZE 20
+
+static uint32_t _get32(const unsigned char* p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void _put32(unsigned char* p, uint32_t v) {
+  for (uint b = 0; b < 4; b++) p[b] = v >> (8 * b);
+}
+
+static uint32_t _checksum(const unsigned char* data, size_t size) {
+  uint32_t h = 0x811c9dc5;
+  for (size_t k = 0; k < size; k++) {
+    h ^= data[k];
+    h *= 0x01000193;
+  }
+  return h;
+}
+
+/** error at a byte offset of a binary file (reported as line 0) */
+static game _binary_error(load_error* err, load_status status, size_t offset, game g) {
+  if (err) *err = (load_error){status, 0, offset + 1};
+  if (g) game_delete(g);
+  return NULL;
+}
+
+static game _load_binary(const unsigned char* buf, size_t size, load_error* err) {
+  if (size < BINARY_HEADER_SIZE) return _binary_error(err, LOAD_ERR_HEADER, size, NULL);
+  if ((buf[4] | buf[5] << 8) != BINARY_VERSION) return _binary_error(err, LOAD_ERR_VERSION, 4, NULL);
+  uint nb_rows = _get32(buf + 8), nb_cols = _get32(buf + 12);
+  if (buf[6] > 1 || buf[7] != 0 || nb_rows == 0 || nb_cols == 0 || (uint64_t)nb_rows * nb_cols > UINT32_MAX)
+    return _binary_error(err, LOAD_ERR_HEADER, 6, NULL);
+  size_t n = (size_t)nb_rows * nb_cols;
+  if (size - BINARY_HEADER_SIZE < n) return _binary_error(err, LOAD_ERR_TRUNCATED, size, NULL);
+  const unsigned char* cells = buf + BINARY_HEADER_SIZE;
+  if (_checksum(cells, n) != _get32(buf + 16)) return _binary_error(err, LOAD_ERR_CHECKSUM, 16, NULL);
+
+  game g = game_new_empty_ext(nb_rows, nb_cols, buf[6]);
+  square* sq = g->squares;
+  for (size_t k = 0; k < n; k++) {
+    if ((cells[k] >> 2) >= NB_SHAPES) return _binary_error(err, LOAD_ERR_SHAPE, BINARY_HEADER_SIZE + k, g);
+    sq[k].s = cells[k] >> 2;
+    sq[k].o = cells[k] & 3;
+  }
+  if (err) *err = (load_error){LOAD_OK, 0, 0};
+  return g;
+}
+
+/* The grid format stores the squares exactly as they are laid out in memory,
+ * so that a game can work directly on a mapped file. Its header takes
+ * GRID_HEADER_SIZE bytes, in little-endian order:
+ *   0: magic "NETM"
+ *   4: version (16 bits)
+ *   6: wrapping (8 bits)
+ *   7: flags (8 bits, 0 for now)
+ *   8: number of rows (32 bits)
+ *  12: number of columns (32 bits)
+ * Then each square takes two bytes, its shape and its orientation, in
+ * row-major order. There is no checksum, since the squares are modified in
+ * place. */
+
+#define GRID_MAGIC "NETM"
+#define GRID_VERSION 1
+#define GRID_HEADER_SIZE 16
+
+/** check the header of a grid file, return the offset of the error if any */
+static load_status _check_grid_header(const unsigned char* buf, size_t size, size_t* offset) {
+  *offset = 0;
+  if (size < GRID_HEADER_SIZE || memcmp(buf, GRID_MAGIC, 4) != 0) return LOAD_ERR_HEADER;
+  *offset = 4;
+  if ((buf[4] | buf[5] << 8) != GRID_VERSION) return LOAD_ERR_VERSION;
+  *offset = 6;
+  uint nb_rows = _get32(buf + 8), nb_cols = _get32(buf + 12);
+  if (buf[6] > 1 || buf[7] != 0 || nb_rows == 0 || nb_cols == 0 || (uint64_t)nb_rows * nb_cols > UINT32_MAX)
+    return LOAD_ERR_HEADER;
+  *offset = size;
+  if ((size - GRID_HEADER_SIZE) / sizeof(square) < (size_t)nb_rows * nb_cols) return LOAD_ERR_TRUNCATED;
+  return LOAD_OK;
+}
+
+static game _load_grid(const unsigned char* buf, size_t size, load_error* err) {
+  size_t offset;
+  load_status status = _check_grid_header(buf, size, &offset);
+  if (status != LOAD_OK) return _binary_error(err, status, offset, NULL);
+  game g = game_new_empty_ext(_get32(buf + 8), _get32(buf + 12), buf[6]);
+  size_t n = (size_t)g->nb_rows * g->nb_cols;
+  const unsigned char* cells = buf + GRID_HEADER_SIZE;
+  for (size_t k = 0; k < n; k++) {
+    if (cells[2 * k] >= NB_SHAPES) return _binary_error(err, LOAD_ERR_SHAPE, GRID_HEADER_SIZE + 2 * k, g);
+    if (cells[2 * k + 1] >= NB_DIRS) return _binary_error(err, LOAD_ERR_ORIENTATION, GRID_HEADER_SIZE + 2 * k + 1, g);
+  }
+  memcpy(g->squares, cells, n * sizeof(square));
+  if (err) *err = (load_error){LOAD_OK, 0, 0};
+  return g;
+}
+
+game game_load_from_buffer(const char* buffer, size_t size, load_error* err) {
+  assert(buffer || size == 0);
+  if (size >= 4 && memcmp(buffer, BINARY_MAGIC, 4) == 0) return _load_binary((const unsigned char*)buffer, size, err);
+  if (size >= 4 && memcmp(buffer, GRID_MAGIC, 4) == 0) return _load_grid((const unsigned char*)buffer, size, err);
+  return _load_text(buffer, size, err);
+}
+
+game game_load_ext(char* filename, load_error* err) {
+  cursor c = {NULL, NULL, NULL, 0};
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) return _load_error(err, LOAD_ERR_OPEN, &c, NULL);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return _load_error(err, LOAD_ERR_OPEN, &c, NULL);
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    return game_load_from_buffer(NULL, 0, err);
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return _load_error(err, LOAD_ERR_OPEN, &c, NULL);
+  game g = game_load_from_buffer(data, st.st_size, err);
+  munmap(data, st.st_size);
+  return g;
+}
 
-/** add an half-edge in the direction d */
-static void _add_half_edge(game g, uint i, uint j, direction d) {
+game game_load(char* filename) { return game_load_ext(filename, NULL); }
+
+game game_map_file(char* filename, bool writable) {
+  assert(filename);
+  assert(sizeof(square) == 2);  // the squares are used as stored in the file
+  int fd = open(filename, writable ? O_RDWR : O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < GRID_HEADER_SIZE) {
+    close(fd);
+    return NULL;
+  }
+  // a private mapping is still writable: the moves are just not saved
+  void* data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return NULL;
+  size_t offset;
+  if (_check_grid_header(data, st.st_size, &offset) != LOAD_OK) {
+    munmap(data, st.st_size);
+    return NULL;
+  }
+  const unsigned char* header = data;
+  game g = (game)_game_malloc(ALLOC_GAME, sizeof(struct game_s));
   assert(g);
-  assert(i < game_nb_rows(g));
-  assert(j < game_nb_cols(g));
-  assert(d < NB_DIRS);
-
-  shape s = game_get_piece_shape(g, i, j);
-  direction o = game_get_piece_orientation(g, i, j);
-  uint code = _encode_shape(s, o);
-  uint mask = 0b1000 >> d;     // mask with half-edge in the direction d
-  assert((code & mask) == 0);  // check there is no half-edge in the direction d
-  uint newcode = code | mask;  // add the half-edge in the direction d
-  shape news;
-  direction newo;
-  bool ok = _decode_shape(newcode, &news, &newo);
-  assert(ok);
-  game_set_piece_shape(g, i, j, news);
-  game_set_piece_orientation(g, i, j, newo);
+  g->nb_rows = _get32(header + 8);
+  g->nb_cols = _get32(header + 12);
+  g->wrapping = header[6];
+  g->squares = (square*)(header + GRID_HEADER_SIZE);
+  g->map = data;
+  g->map_size = st.st_size;
+  g->journal = NULL;
+  g->undo_stack = queue_new();
+  g->redo_stack = queue_new();
+  assert(g->undo_stack && g->redo_stack);
+  return g;
 }
 
-/* ************************************************************************** */
+const char* game_load_error_message(load_status status) {
+  assert(status < sizeof(_load_messages) / sizeof(_load_messages[0]));
+  return _load_messages[status];
+}
 
-#define OPPOSITE_DIR(d) ((d + 2) % NB_DIRS)
+/* ************************************************************************** */
 
+/* ************************************************************************** */
+/*                                   SAVING                                   */
 /* ************************************************************************** */
 
-/**
- * @brief Add an edge between two adjacent squares.
- * @details This is done by modifying the pieces of the two adjacent squares.
- * More precisely, we add an half-edge to each adjacent square, so as to build
- * an edge between these two squares.
- * @param g the game
- * @param i row index
- * @param j column index
- * @param d the direction of the adjacent square
- * @pre @p g must be a valid pointer toward a game structure.
- * @pre @p i < game height
- * @pre @p j < game width
- * @return true if an edge can be added, false otherwise
- */
-static bool _add_edge(game g, uint i, uint j, direction d) {
-  assert(g);
-  assert(i < game_nb_rows(g));
-  assert(j < game_nb_cols(g));
-  assert(d < NB_DIRS);
+static const char _shape2char[NB_SHAPES] = {'E', 'N', 'S', 'C', 'T', 'X'};
+static const char _dir2char[NB_DIRS] = {'N', 'E', 'S', 'W'};
 
-  uint nexti, nextj;
-  bool next = game_get_ajacent_square(g, i, j, d, &nexti, &nextj);
-  if (!next) return false;
+/** maximal size of the text description: header, then 3 characters per square
+ * and a newline per row */
+static size_t _text_size(cgame g) { return 3 * 11 + (size_t)g->nb_rows * (3 * (size_t)g->nb_cols + 1); }
 
-  // check if the two half-edges are free
-  bool he = game_has_half_edge(g, i, j, d);
-  if (he) return false;
-  bool next_he = game_has_half_edge(g, nexti, nextj, OPPOSITE_DIR(d));
-  if (next_he) return false;
+/** write the text description into buf (large enough), return its length */
+static size_t _write_text(cgame g, char* buf) {
+  char* p = buf + sprintf(buf, "%u %u %d\n", g->nb_rows, g->nb_cols, g->wrapping);
+  const square* sq = g->squares;
+  for (uint i = 0; i < g->nb_rows; i++) {
+    for (uint j = 0; j < g->nb_cols; j++, sq++) {
+      p[0] = _shape2char[sq->s];
+      p[1] = _dir2char[sq->o];
+      p[2] = ' ';
+      p += 3;
+    }
+    *p++ = '\n';
+  }
+  return p - buf;
+}
 
-  _add_half_edge(g, i, j, d);
-  _add_half_edge(g, nexti, nextj, OPPOSITE_DIR(d));
+char* game_save_to_buffer(cgame g, size_t* size) {
+  assert(g && size);
+  char* buf = malloc(_text_size(g) + 1);
+  if (buf == NULL) return NULL;
+  *size = _write_text(g, buf);
+  buf[*size] = '\0';
+  return buf;
+}
 
-  return true;
+/** write a file atomically: the content goes to a temporary file next to the
+ * target, which is then renamed over the target, so that the file is either
+ * the old one or the complete new one. The temporary file gets a unique name
+ * (mkstemp), so that several threads may save the same file at once. */
+static bool _write_file(const char* filename, const char* buf, size_t size) {
+  size_t len = strlen(filename) + 32;
+  char* tmp = _game_malloc(ALLOC_IO, len);
+  if (tmp == NULL) return false;
+  snprintf(tmp, len, "%s.XXXXXX", filename);
+  int fd = mkstemp(tmp);
+  bool ok = (fd >= 0) && fchmod(fd, 0644) == 0;
+  for (size_t done = 0; ok && done < size;) {
+    ssize_t n = write(fd, buf + done, size - done);
+    if (n < 0 && errno == EINTR) continue;
+    ok = (n > 0);
+    if (ok) done += n;
+  }
+  if (fd >= 0) {
+    ok = ok && fsync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+  }
+  ok = ok && rename(tmp, filename) == 0;
+  if (!ok && fd >= 0) unlink(tmp);
+  _game_free(tmp);
+  return ok;
+}
+
+bool game_save(cgame g, char* filename) {
+  if (g == NULL || filename == NULL) return false;
+  size_t size;
+  char* buf = game_save_to_buffer(g, &size);
+  if (buf == NULL) return false;
+  bool ok = _write_file(filename, buf, size);
+  free(buf);
+  return ok;
+}
+
+bool game_save_file(cgame g, FILE* file) {
+  assert(g && file);
+  size_t size;
+  char* buf = game_save_to_buffer(g, &size);
+  if (buf == NULL) return false;
+  bool ok = fwrite(buf, 1, size, file) == size;
+  free(buf);
+  return ok;
+}
+
+char* game_save_binary_to_buffer(cgame g, size_t* size) {
+  assert(g && size);
+  size_t n = (size_t)g->nb_rows * g->nb_cols;
+  unsigned char* buf = malloc(BINARY_HEADER_SIZE + n);
+  if (buf == NULL) return NULL;
+  memcpy(buf, BINARY_MAGIC, 4);
+  buf[4] = BINARY_VERSION & 0xFF;
+  buf[5] = BINARY_VERSION >> 8;
+  buf[6] = g->wrapping;
+  buf[7] = 0;
+  _put32(buf + 8, g->nb_rows);
+  _put32(buf + 12, g->nb_cols);
+  unsigned char* cells = buf + BINARY_HEADER_SIZE;
+  for (size_t k = 0; k < n; k++) cells[k] = g->squares[k].s << 2 | g->squares[k].o;
+  _put32(buf + 16, _checksum(cells, n));
+  *size = BINARY_HEADER_SIZE + n;
+  return (char*)buf;
+}
+
+bool game_save_binary(cgame g, char* filename) {
+  if (g == NULL || filename == NULL) return false;
+  size_t size;
+  char* buf = game_save_binary_to_buffer(g, &size);
+  if (buf == NULL) return false;
+  bool ok = _write_file(filename, buf, size);
+  free(buf);
+  return ok;
+}
+
+bool game_save_binary_file(cgame g, FILE* file) {
+  assert(g && file);
+  size_t size;
+  char* buf = game_save_binary_to_buffer(g, &size);
+  if (buf == NULL) return false;
+  bool ok = fwrite(buf, 1, size, file) == size;
+  free(buf);
+  return ok;
+}
+
+char* game_save_grid_to_buffer(cgame g, size_t* size) {
+  assert(g && size);
+  size_t n = (size_t)g->nb_rows * g->nb_cols;
+  unsigned char* buf = malloc(GRID_HEADER_SIZE + n * sizeof(square));
+  if (buf == NULL) return NULL;
+  memcpy(buf, GRID_MAGIC, 4);
+  buf[4] = GRID_VERSION & 0xFF;
+  buf[5] = GRID_VERSION >> 8;
+  buf[6] = g->wrapping;
+  buf[7] = 0;
+  _put32(buf + 8, g->nb_rows);
+  _put32(buf + 12, g->nb_cols);
+  memcpy(buf + GRID_HEADER_SIZE, g->squares, n * sizeof(square));
+  *size = GRID_HEADER_SIZE + n * sizeof(square);
+  return (char*)buf;
+}
+
+bool game_save_grid(cgame g, char* filename) {
+  if (g == NULL || filename == NULL) return false;
+  size_t size;
+  char* buf = game_save_grid_to_buffer(g, &size);
+  if (buf == NULL) return false;
+  bool ok = _write_file(filename, buf, size);
+  free(buf);
+  return ok;
 }
 
 /* ************************************************************************** */
 
-game game_load(char* filename) {
-  FILE* g_file = fopen(filename, "r");
-  if (g_file == NULL) {
-    exit(EXIT_FAILURE);
+/** decoding of the half-edge codes, i.e. the inverse of @ref _code */
+static const shape _code2shape[16] = {
+    EMPTY,    ENDPOINT, ENDPOINT, CORNER,  // 0000, 0001, 0010, 0011
+    ENDPOINT, SEGMENT,  CORNER,   TEE,     // 0100, 0101, 0110, 0111
+    ENDPOINT, CORNER,   SEGMENT,  TEE,     // 1000, 1001, 1010, 1011
+    CORNER,   TEE,      TEE,      CROSS,   // 1100, 1101, 1110, 1111
+};
+
+static const direction _code2dir[16] = {
+    NORTH, WEST,  SOUTH, SOUTH,  // 0000, 0001, 0010, 0011
+    EAST,  EAST,  EAST,  SOUTH,  // 0100, 0101, 0110, 0111
+    NORTH, WEST,  NORTH, WEST,   // 1000, 1001, 1010, 1011
+    NORTH, NORTH, EAST,  NORTH,  // 1100, 1101, 1110, 1111
+};
+
+/* ************************************************************************** */
+
+/** index of the adjacent square in direction d (false if out of grid) */
+static bool _neighbor(uint nb_rows, uint nb_cols, bool wrapping, uint idx, direction d, uint* next) {
+  uint i = idx / nb_cols;
+  uint j = idx % nb_cols;
+  switch (d) {
+    case NORTH:
+      if (i == 0 && !wrapping) return false;
+      i = (i == 0) ? nb_rows - 1 : i - 1;
+      break;
+    case EAST:
+      if (j == nb_cols - 1 && !wrapping) return false;
+      j = (j == nb_cols - 1) ? 0 : j + 1;
+      break;
+    case SOUTH:
+      if (i == nb_rows - 1 && !wrapping) return false;
+      i = (i == nb_rows - 1) ? 0 : i + 1;
+      break;
+    default:
+      if (j == 0 && !wrapping) return false;
+      j = (j == 0) ? nb_cols - 1 : j - 1;
+      break;
   }
-  int nb_rows, nb_cols, wrapping;
-  if (fscanf(g_file, "%d %d %d\n", &nb_rows, &nb_cols, &wrapping) != 3) {
-    exit(EXIT_FAILURE);
+  *next = i * nb_cols + j;
+  return true;
+}
+
+/* ************************************************************************** */
+
+/* square states used to grow the spanning tree */
+typedef enum {
+  OUTSIDE,  /* square not yet reached */
+  FRONTIER, /* square adjacent to the tree */
+  INSIDE,   /* square in the tree */
+} treestate;
+
+/** add an edge between a square and its neighbor in direction d */
+static void _link(unsigned char* codes, uint idx, uint next, direction d) {
+  codes[idx] |= 0b1000 >> d;
+  codes[next] |= 0b1000 >> OPPOSITE_DIR(d);
+}
+
+/**
+ * @brief Grows a random spanning tree over the whole grid (randomized Prim's
+ * algorithm).
+ * @details Each step picks a random square in the frontier, in O(1) with a
+ * swap-remove, and connects it to a random neighbor already in the tree, so
+ * the overall cost is linear in the number of squares. The result is written
+ * in @p codes as half-edge codes (see @ref _code).
+ */
+static bool _random_tree(uint nb_rows, uint nb_cols, bool wrapping, unsigned char* codes, prng* rng) {
+  uint size = nb_rows * nb_cols;
+  uint* frontier = _game_malloc(ALLOC_GENERATOR, size * sizeof(uint));
+  unsigned char* state = _game_calloc(ALLOC_GENERATOR, size, sizeof(unsigned char));
+  if (!frontier || !state) {
+    _game_free(frontier);
+    _game_free(state);
+    return false;
   }
-  game g = game_new_empty_ext(nb_rows, nb_cols, wrapping);
-  if (g == NULL) {
-    exit(EXIT_FAILURE);
-  }
-  for (int i = 0; i < nb_rows; i++) {
-    for (int j = 0; j < nb_cols; j++) {
-      int c_s = fgetc(g_file);
-      int c_d = fgetc(g_file);
-      fgetc(g_file);
-      if ((c_s != EOF && c_d != EOF)) {
-        switch (c_s) {
-          case ('E'):
-            game_set_piece_shape(g, i, j, EMPTY);
-            break;
-          case ('N'):
-            game_set_piece_shape(g, i, j, ENDPOINT);
-            break;
-          case ('S'):
-            game_set_piece_shape(g, i, j, SEGMENT);
-            break;
-          case ('C'):
-            game_set_piece_shape(g, i, j, CORNER);
-            break;
-          case ('T'):
-            game_set_piece_shape(g, i, j, TEE);
-            break;
-          case ('X'):
-            game_set_piece_shape(g, i, j, CROSS);
-            break;
-          default:
-            exit(EXIT_FAILURE);
-        }
 
-        switch (c_d) {
-          case ('N'):
-            game_set_piece_orientation(g, i, j, NORTH);
-            break;
-          case ('E'):
-            game_set_piece_orientation(g, i, j, EAST);
-            break;
-          case ('S'):
-            game_set_piece_orientation(g, i, j, SOUTH);
-            break;
-          case ('W'):
-            game_set_piece_orientation(g, i, j, WEST);
-            break;
-          default:
-            exit(EXIT_FAILURE);
-        }
+  uint nb_frontier = 0;
+  uint idx = prng_uniform(rng, size);
+  state[idx] = INSIDE;
+  for (uint nb_inside = 1; nb_inside <= size; nb_inside++) {
+    // push the neighbors of the new square, and choose a random one in the tree
+    direction dirs[NB_DIRS];
+    uint nexts[NB_DIRS];
+    uint nb_dirs = 0;
+    for (direction d = 0; d < NB_DIRS; d++) {
+      uint next;
+      if (!_neighbor(nb_rows, nb_cols, wrapping, idx, d, &next) || next == idx) continue;
+      if (state[next] == OUTSIDE) {
+        state[next] = FRONTIER;
+        frontier[nb_frontier++] = next;
+      } else if (state[next] == INSIDE && nb_inside > 1) {
+        dirs[nb_dirs] = d;
+        nexts[nb_dirs] = next;
+        nb_dirs++;
       }
     }
-    fgetc(g_file);
+    if (nb_inside > 1) {
+      assert(nb_dirs > 0);
+      uint r = prng_uniform(rng, nb_dirs);
+      _link(codes, idx, nexts[r], dirs[r]);
+    }
+    if (nb_frontier == 0) break;
+
+    uint k = prng_uniform(rng, nb_frontier);
+    idx = frontier[k];
+    frontier[k] = frontier[--nb_frontier];
+    state[idx] = INSIDE;
   }
-  fclose(g_file);
-  return g;
+
+  _game_free(frontier);
+  _game_free(state);
+  return true;
 }
 
-void game_save(cgame g, char* filename) {
-  if (g == NULL || filename == NULL) {
-    exit(EXIT_FAILURE);
-  }
+/* ************************************************************************** */
 
-  FILE* file = fopen(filename, "w");
-  if (file == NULL) {
-    exit(EXIT_FAILURE);
-  }
-  uint nb_cols = game_nb_cols(g), nb_rows = game_nb_rows(g), wrapping = game_is_wrapping(g);
-  fprintf(file, "%d %d %d\n", nb_rows, nb_cols, wrapping);
+/**
+ * @brief Empties nb_empty squares by pruning random leaves of the tree.
+ * @details Removing a leaf keeps the network connected, and its neighbor may
+ * become a new leaf. Leaves are picked in O(1) with a swap-remove.
+ */
+static bool _prune_leaves(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, unsigned char* codes, prng* rng) {
+  uint size = nb_rows * nb_cols;
+  uint* leaves = _game_malloc(ALLOC_GENERATOR, size * sizeof(uint));
+  if (!leaves) return false;
+  uint nb_leaves = 0;
+  for (uint idx = 0; idx < size; idx++)
+    if (__builtin_popcount(codes[idx]) == 1) leaves[nb_leaves++] = idx;
 
-  char tab_dir[] = {'N', 'E', 'S', 'W'};
-  char tab_shape[] = {'E', 'N', 'S', 'C', 'T', 'X'};
+  for (uint k = 0; k < nb_empty; k++) {
+    assert(nb_leaves > 0);
+    uint r = prng_uniform(rng, nb_leaves);
+    uint idx = leaves[r];
+    leaves[r] = leaves[--nb_leaves];
 
-  for (uint i = 0; i < nb_rows; i++) {
-    for (uint j = 0; j < nb_cols; j++) {
-      fprintf(file, "%c%c ", tab_shape[game_get_piece_shape(g, i, j)], tab_dir[game_get_piece_orientation(g, i, j)]);
-    }
-    fprintf(file, "\n");
+    direction d = 0;
+    while (!(codes[idx] & (0b1000 >> d))) d++;
+    uint next;
+    bool ok = _neighbor(nb_rows, nb_cols, wrapping, idx, d, &next);
+    assert(ok);
+    codes[idx] = 0;
+    codes[next] &= ~(0b1000 >> OPPOSITE_DIR(d));
+    if (__builtin_popcount(codes[next]) == 1) leaves[nb_leaves++] = next;
   }
 
-  fclose(file);
+  _game_free(leaves);
+  return true;
+}
+
+/* ************************************************************************** */
+
+/** check if an extra edge can be added between two squares, the first one
+ * having no half-edge toward the second one in direction d */
+static bool _is_extra_candidate(const unsigned char* codes, uint idx, uint next, direction d) {
+  return (idx != next) & (codes[idx] != 0) & (codes[next] != 0) & !(codes[idx] & (0b1000 >> d));
 }
 
-void remove_d(direction d[], direction del_d, uint* size) {
-  for (int i = 0; i < *size; i++) {
-    if (d[i] == del_d) {
-      memmove(&d[i], &d[i + 1], sizeof(direction) * (*size - 1 - i));
-      (*size)--;
-      return;
+/** collect the candidate extra edges, encoded as 2 * idx for the east edge
+ * and 2 * idx + 1 for the south edge of square idx (branch-free, as the
+ * outcome is random) */
+static uint _extra_candidates(uint nb_rows, uint nb_cols, bool wrapping, const unsigned char* codes, uint* candidates) {
+  uint nb_candidates = 0;
+  for (uint i = 0; i < nb_rows; i++) {
+    bool has_south = (i + 1 < nb_rows) || wrapping;
+    uint south_row = (i + 1 < nb_rows) ? (i + 1) * nb_cols : 0;
+    for (uint j = 0; j < nb_cols; j++) {
+      uint idx = i * nb_cols + j;
+      bool has_east = (j + 1 < nb_cols) || wrapping;
+      uint east = (j + 1 < nb_cols) ? idx + 1 : i * nb_cols;
+      candidates[nb_candidates] = 2 * idx;
+      nb_candidates += has_east && _is_extra_candidate(codes, idx, east, EAST);
+      candidates[nb_candidates] = 2 * idx + 1;
+      nb_candidates += has_south && _is_extra_candidate(codes, idx, south_row + j, SOUTH);
     }
   }
+  return nb_candidates;
 }
 
-bool get_empty_case(game g, uint* ii, uint* jj, direction* dd) {
-  int offset[NB_DIRS][2] = {{-1, 0}, {0, 1}, {1, 0}, {0, -1}};
-  queue* q_cases = queue_new();
-  for (uint i = 0; i < g->nb_rows; i++) {
-    for (uint j = 0; j < g->nb_cols; j++) {
-      if (game_get_piece_shape(g, i, j) != EMPTY) {  // check all not empty shape cases
-                                                     // prevent seg err function get piece shape
-        direction possible_adj[] = {NORTH, EAST, SOUTH, WEST};
-        uint d_size = 4;
-        if (i == 0) remove_d(possible_adj, NORTH, &d_size);
-        if (i == g->nb_rows - 1) remove_d(possible_adj, SOUTH, &d_size);
-        if (j == 0) remove_d(possible_adj, WEST, &d_size);
-        if (j == g->nb_cols - 1) remove_d(possible_adj, EAST, &d_size);
-        for (uint d = 0; d < d_size; d++) {
-          // get all adjacent empty case and push into queue
-          if (game_get_piece_shape(g, i + offset[possible_adj[d]][0], j + offset[possible_adj[d]][1]) == EMPTY) {
-            uint* has_shape = malloc(sizeof(uint) * 3);
-            if (has_shape == NULL) {
-              fprintf(stderr, "Not enough memory\n");
-              return false;
-            }
-            has_shape[0] = i;
-            has_shape[1] = j;
-            has_shape[2] = possible_adj[d];
-            queue_push_tail(q_cases, has_shape);
-          }
-        }
-      }
-    }
+/**
+ * @brief Adds nb_extra random edges between non-empty adjacent squares.
+ * @details All the candidate edges are collected once (looking only east and
+ * south, so that each edge is seen once), then sampled without replacement
+ * with a partial Fisher-Yates shuffle. Adding an edge only uses its own two
+ * half-edges, so the other candidates remain eligible and the sample is
+ * uniform over the whole board. If there are less candidates than nb_extra,
+ * all of them are added.
+ */
+static bool _add_extra_edges(uint nb_rows, uint nb_cols, bool wrapping, uint nb_extra, unsigned char* codes, prng* rng) {
+  if (nb_extra == 0) return true;
+  uint* candidates = _game_malloc(ALLOC_GENERATOR, (2 * nb_rows * nb_cols + 1) * sizeof(uint));
+  if (!candidates) return false;
+  uint nb_candidates = _extra_candidates(nb_rows, nb_cols, wrapping, codes, candidates);
+
+  uint nb = MIN(nb_extra, nb_candidates);
+  for (uint k = 0; k < nb; k++) {
+    uint r = k + prng_uniform(rng, nb_candidates - k);
+    uint c = candidates[r];
+    candidates[r] = candidates[k];
+    uint idx = c / 2, next;
+    direction d = (c % 2) ? SOUTH : EAST;
+    _neighbor(nb_rows, nb_cols, wrapping, idx, d, &next);
+    _link(codes, idx, next, d);
   }
-  if (queue_length(q_cases) == 0) {
-    queue_free_full(q_cases, free);
-    return false;
-  };
-  // to get a random choice
-  uint random_case = rand() % queue_length(q_cases);
-  for (uint i = 0; i < random_case; i++) {
-    free(queue_pop_head(q_cases));
-  }
-  // pass the value and free memory
-  uint* choosen_case = queue_pop_head(q_cases);
-  *ii = choosen_case[0];
-  *jj = choosen_case[1];
-  *dd = choosen_case[2];
-  queue_free_full(q_cases, free);
-  free(choosen_case);
+
+  _game_free(candidates);
   return true;
 }
+
+/* ************************************************************************** */
+
 game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra) {
+  // draw the seed from rand(), so that srand() still makes the result reproducible
+  prng rng;
+  prng_seed(&rng, ((uint64_t)rand() << 32) ^ (uint64_t)rand());
+  return game_random_ext(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, &rng);
+}
+
+/* ************************************************************************** */
+
+/** build the half-edge codes of a random network, or return NULL if the
+ * preconditions of game_random_ext are not met */
+static unsigned char* _random_codes(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, prng* rng) {
   if (nb_cols * nb_rows < 2 || nb_empty > (nb_cols * nb_rows - 2) || nb_extra > nb_cols * nb_rows - nb_empty) return NULL;
-  // place aléatoirement sur la grille vide un jeu solution à 2 pièces, c'est-à-dire > < horizontal ou
-  // vertical
+  uint size = nb_rows * nb_cols;
+
+  unsigned char* codes = _game_calloc(ALLOC_GENERATOR, size, sizeof(unsigned char));
+  if (codes == NULL) return NULL;
+  if (!_random_tree(nb_rows, nb_cols, wrapping, codes, rng) || !_prune_leaves(nb_rows, nb_cols, wrapping, nb_empty, codes, rng) ||
+      !_add_extra_edges(nb_rows, nb_cols, wrapping, nb_extra, codes, rng)) {
+    _game_free(codes);
+    return NULL;
+  }
+  return codes;
+}
+
+/** create the game solution described by the half-edge codes */
+static game _codes2game(uint nb_rows, uint nb_cols, bool wrapping, const unsigned char* codes) {
   game g = game_new_empty_ext(nb_rows, nb_cols, wrapping);
-  if (g == NULL) return NULL;
-  uint nb_cases = nb_cols * nb_rows;
-  uint i = (((double)rand() * nb_rows) / RAND_MAX);
-  uint j = (((double)rand() * nb_cols) / RAND_MAX);
-  uint d;
-  // wrapping have more possibility to forme a game
-  if (wrapping) {
-    d = (((double)rand() * NB_DIRS) / RAND_MAX);
-  } else {
-    // not wrapping
-    direction all_d[] = {NORTH, EAST, SOUTH, WEST};
-    uint size = NB_DIRS;
-    if (i == 0) remove_d(all_d, NORTH, &size);
-    if (i == nb_rows - 1) remove_d(all_d, SOUTH, &size);
-    if (j == 0) remove_d(all_d, WEST, &size);
-    if (j == nb_cols - 1) remove_d(all_d, EAST, &size);
-    d = all_d[rand() % size];
-  }
-  // initialization
-  _add_edge(g, i, j, d);
-  nb_cases -= 2;
-
-  // Loop adding edge
-  direction p_d;
-  uint p_i, p_j;
-  while (nb_cases > nb_empty) {
-    if (get_empty_case(g, &p_i, &p_j, &p_d)) {
-      if (_add_edge(g, p_i, p_j, p_d) && game_is_connected(g)) {
-        nb_cases--;
-      } else {
-        printf("err\n");
-        game_delete(g);
-        return NULL;
-      }
-    } else {
-      game_delete(g);
-      return NULL;
-    }
+  for (uint k = 0; k < nb_rows * nb_cols; k++) {
+    g->squares[k].s = _code2shape[codes[k]];
+    g->squares[k].o = _code2dir[codes[k]];
+    assert(_encode_shape(g->squares[k].s, g->squares[k].o) == codes[k]);
+  }
+  return g;
+}
+
+game game_random_ext(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, prng* rng) {
+  assert(rng);
+  unsigned char* codes = _random_codes(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, rng);
+  if (codes == NULL) return NULL;
+  game g = _codes2game(nb_rows, nb_cols, wrapping, codes);
+  _game_free(codes);
+  return g;
+}
+
+/* ************************************************************************** */
+/*                                   SOLVER                                   */
+/* ************************************************************************** */
+
+/* The solver works on the domain of each square, i.e. the set of orientations
+ * that are still possible, stored as a 4-bit mask (bit o for orientation o).
+ * Symmetrical orientations are removed from the start, so that each solution
+ * is found only once. The domains are filtered by propagating the edge
+ * constraints between neighbors: if no orientation of a neighbor has a half-edge
+ * towards a square, then this square cannot have a half-edge towards it, and
+ * conversely. When propagation is stuck, the solver branches on a square with
+ * the smallest domain. Every change of a domain is recorded on a trail, so that
+ * backtracking only undoes what has been done since the branch point. */
+
+#define NO_NEIGHBOR UINT32_MAX
+
+typedef struct {
+  uint nb_rows, nb_cols;
+  uint size;              /* number of squares */
+  uint nb_nonempty;       /* number of non-empty squares */
+  unsigned char* shapes;  /* shape of each square */
+  unsigned char* domains; /* possible orientations of each square */
+  uint32_t* neighbors;    /* index of the 4 neighbors of each square */
+  uint32_t* trail;        /* changed squares, with their old domain */
+  unsigned char* trail_domains;
+  uint trail_size;
+  uint32_t* work; /* squares to revise */
+  bool* in_work;
+  uint work_size;
+  uint32_t* bfs; /* for the connectivity check */
+  bool* seen;
+  unsigned char* solution; /* orientations of the first solution found */
+  unsigned char* other;    /* orientations of the second one */
+  uint max;                /* stop after max solutions (0 = no limit) */
+  /* half-edges that are present in at least one (may) or in every (must)
+   * orientation of a domain, for each shape */
+  unsigned char may[NB_SHAPES][16], must[NB_SHAPES][16];
+  game_stats stats;
+  solver_progress progress; /* called every SOLVER_PROGRESS_NODES nodes, if not NULL */
+  void* progress_data;
+  bool stopped; /* the progress callback stopped the search */
+} solver;
+
+/** orientations to consider for each shape, without the symmetrical ones */
+static unsigned char _initial_domain(shape s) {
+  switch (s) {
+    case EMPTY:
+    case CROSS:
+      return 0x1;  // {N}
+    case SEGMENT:
+      return 0x3;  // {N, E}
+    default:
+      return 0xF;
   }
-  for (uint k = 0; k < nb_extra; k++) {
-    uint extra_i, extra_j, neighbor_i, neighbor_j;
-    direction extra_d;
-    bool cycle_created = false;
-
-    // Finding edges that can be connected
-    for (uint i = 0; i < nb_rows && !cycle_created; i++) {
-      for (uint j = 0; j < nb_cols && !cycle_created; j++) {
-        if (game_get_piece_shape(g, i, j) != EMPTY) {
-          for (uint d = 0; d < NB_DIRS; d++) {
-            if (game_get_ajacent_square(g, i, j, d, &neighbor_i, &neighbor_j)) {
-              if (game_get_piece_shape(g, neighbor_i, neighbor_j) != EMPTY && !game_has_half_edge(g, i, j, d) &&
-                  !game_has_half_edge(g, neighbor_i, neighbor_j, OPPOSITE_DIR(d))) {
-                extra_i = i;
-                extra_j = j;
-                extra_d = d;
-                cycle_created = true;
-                break;
-              }
-            }
-          }
+}
+
+static uint _popcount4(unsigned char dom) { return (dom & 1) + ((dom >> 1) & 1) + ((dom >> 2) & 1) + ((dom >> 3) & 1); }
+
+static uint _lowest_bit(unsigned char dom) {
+  uint o = 0;
+  while (!(dom & (1 << o))) o++;
+  return o;
+}
+
+static void _solver_alloc(solver* sv, uint nb_rows, uint nb_cols, bool wrapping) {
+  memset(sv, 0, sizeof(solver));
+  for (uint s = 0; s < NB_SHAPES; s++)
+    for (uint dom = 0; dom < 16; dom++) {
+      sv->must[s][dom] = 0xF;
+      for (uint o = 0; o < NB_DIRS; o++)
+        if (dom & (1 << o)) {
+          sv->may[s][dom] |= _code[s][o];
+          sv->must[s][dom] &= _code[s][o];
         }
-      }
     }
+  sv->nb_rows = nb_rows;
+  sv->nb_cols = nb_cols;
+  sv->size = nb_rows * nb_cols;
+  uint n = sv->size;
+  sv->shapes = _game_malloc(ALLOC_SOLVER, n);
+  sv->domains = _game_malloc(ALLOC_SOLVER, n);
+  sv->neighbors = _game_malloc(ALLOC_SOLVER, 4 * n * sizeof(uint32_t));
+  // along a branch, domains only shrink, so each square is changed at most 4 times
+  sv->trail = _game_malloc(ALLOC_SOLVER, 4 * n * sizeof(uint32_t));
+  sv->trail_domains = _game_malloc(ALLOC_SOLVER, 4 * n);
+  sv->work = _game_malloc(ALLOC_SOLVER, n * sizeof(uint32_t));
+  sv->in_work = _game_calloc(ALLOC_SOLVER, n, sizeof(bool));
+  sv->bfs = _game_malloc(ALLOC_SOLVER, n * sizeof(uint32_t));
+  sv->seen = _game_malloc(ALLOC_SOLVER, n * sizeof(bool));
+  sv->solution = _game_malloc(ALLOC_SOLVER, n);
+  sv->other = _game_malloc(ALLOC_SOLVER, n);
+  assert(sv->shapes && sv->domains && sv->neighbors && sv->trail && sv->trail_domains && sv->work && sv->in_work &&
+         sv->bfs && sv->seen && sv->solution && sv->other);
+  for (uint k = 0; k < n; k++)
+    for (direction d = 0; d < NB_DIRS; d++) {
+      uint next;
+      sv->neighbors[4 * k + d] = _neighbor(nb_rows, nb_cols, wrapping, k, d, &next) ? next : NO_NEIGHBOR;
+    }
+}
+
+/** prepare a new search on the current shapes, reusing the allocated memory */
+static void _solver_reset(solver* sv, uint max) {
+  sv->max = max;
+  sv->stopped = false;
+  memset(&sv->stats, 0, sizeof(game_stats));
+  sv->nb_nonempty = 0;
+  sv->trail_size = 0;
+  for (uint k = 0; k < sv->size; k++) {
+    sv->domains[k] = _initial_domain(sv->shapes[k]);
+    if (sv->shapes[k] != EMPTY) sv->nb_nonempty++;
+    if (_popcount4(sv->domains[k]) > 1) sv->stats.nb_squares++;
+    sv->work[k] = k;
+    sv->in_work[k] = true;
+  }
+  sv->work_size = sv->size;
+}
 
-    if (!cycle_created) {
-      printf("Erreur: Cycles could not be created.\n");
-      game_delete(g);
-      return NULL;
+static void _solver_free(solver* sv) {
+  _game_free(sv->shapes);
+  _game_free(sv->domains);
+  _game_free(sv->neighbors);
+  _game_free(sv->trail);
+  _game_free(sv->trail_domains);
+  _game_free(sv->work);
+  _game_free(sv->in_work);
+  _game_free(sv->bfs);
+  _game_free(sv->seen);
+  _game_free(sv->solution);
+  _game_free(sv->other);
+}
+
+static void _set_domain(solver* sv, uint k, unsigned char dom) {
+  sv->trail[sv->trail_size] = k;
+  sv->trail_domains[sv->trail_size] = sv->domains[k];
+  sv->trail_size++;
+  sv->domains[k] = dom;
+  for (direction d = 0; d < NB_DIRS; d++) {
+    uint32_t next = sv->neighbors[4 * k + d];
+    if (next != NO_NEIGHBOR && !sv->in_work[next]) {
+      sv->in_work[next] = true;
+      sv->work[sv->work_size++] = next;
     }
+  }
+}
 
-    if (!_add_edge(g, extra_i, extra_j, extra_d)) {
-      printf("Erreur: Edge could not be added.\n");
-      game_delete(g);
-      return NULL;
+static void _undo(solver* sv, uint mark) {
+  while (sv->trail_size > mark) {
+    sv->trail_size--;
+    sv->domains[sv->trail[sv->trail_size]] = sv->trail_domains[sv->trail_size];
+  }
+}
+
+/** remove from the domain of square k the orientations that do not fit with
+ * its neighbors, return false if the domain becomes empty */
+static bool _revise(solver* sv, uint k) {
+  unsigned char on = 0, off = 0;  // half-edges that must be present / absent
+  for (direction d = 0; d < NB_DIRS; d++) {
+    unsigned char bit = 0x8 >> d, opposite = 0x8 >> OPPOSITE_DIR(d);
+    uint32_t next = sv->neighbors[4 * k + d];
+    if (next == NO_NEIGHBOR) {
+      off |= bit;
+      continue;
     }
+    if (!(sv->may[sv->shapes[next]][sv->domains[next]] & opposite)) off |= bit;
+    if (sv->must[sv->shapes[next]][sv->domains[next]] & opposite) on |= bit;
   }
-  return g;
+  unsigned char dom = sv->domains[k], new_dom = 0;
+  for (uint o = 0; o < NB_DIRS; o++) {
+    uint code = _code[sv->shapes[k]][o];
+    if ((dom & (1 << o)) && (code & on) == on && !(code & off)) new_dom |= 1 << o;
+  }
+  if (new_dom != dom) _set_domain(sv, k, new_dom);
+  return new_dom != 0;
 }
-bool check(game g, uint pos) {
-  uint i = pos / g->nb_cols;
-  uint j = pos % g->nb_cols;
 
-  if (game_is_wrapping(g)) {
-    if ((i > 0 && game_check_edge(g, i, j, NORTH) == MISMATCH) || (j > 0 && game_check_edge(g, i, j, WEST) == MISMATCH)) return false;
-    // Vérifier les bords opposés dans le cas de wrapping
-    if ((i == g->nb_rows - 1 && game_check_edge(g, i, j, SOUTH) == MISMATCH) || (j == g->nb_cols - 1 && game_check_edge(g, i, j, EAST) == MISMATCH))
-      return false;
-  } else {
-    if (game_check_edge(g, i, j, NORTH) == MISMATCH || game_check_edge(g, i, j, WEST) == MISMATCH) return false;
+static bool _propagate(solver* sv) {
+  bool ok = true;
+  while (sv->work_size > 0) {
+    uint k = sv->work[--sv->work_size];
+    sv->in_work[k] = false;
+    if (ok && !_revise(sv, k)) ok = false;  // keep on emptying the work list
   }
-  return true;
+  return ok;
 }
 
-void solve_rec(game g, uint pos, bool onlyfirst, uint size, uint* cpt) {
-  if (pos == size) {
-    if (game_won(g)) {
-      (*cpt)++;
-      printf("Solution %d trouvée !\n", *cpt);
-      game_print(g);
+/** check that the non-empty squares can still be connected, using all the
+ * edges that are possible with the current domains (exact at the leaves) */
+static bool _may_be_connected(solver* sv) {
+  uint start = 0;
+  while (start < sv->size && sv->shapes[start] == EMPTY) start++;
+  if (start == sv->size) return true;
+  memset(sv->seen, 0, sv->size * sizeof(bool));
+  uint head = 0, tail = 0, nb_seen = 1;
+  sv->bfs[tail++] = start;
+  sv->seen[start] = true;
+  while (head < tail) {
+    uint k = sv->bfs[head++];
+    unsigned char may = sv->may[sv->shapes[k]][sv->domains[k]];
+    for (direction d = 0; d < NB_DIRS; d++) {
+      uint32_t next = sv->neighbors[4 * k + d];
+      if (!(may & (0x8 >> d)) || next == NO_NEIGHBOR || sv->seen[next]) continue;
+      if (!(sv->may[sv->shapes[next]][sv->domains[next]] & (0x8 >> OPPOSITE_DIR(d)))) continue;
+      sv->seen[next] = true;
+      sv->bfs[tail++] = next;
+      nb_seen++;
     }
+  }
+  return nb_seen == sv->nb_nonempty;
+}
+
+static void _search(solver* sv, uint depth) {
+  sv->stats.nb_nodes++;
+  if (sv->progress && sv->stats.nb_nodes % SOLVER_PROGRESS_NODES == 1 && !sv->progress(&sv->stats, sv->progress_data))
+    sv->stopped = true;
+  if (sv->stopped) return;
+  if (!_propagate(sv) || !_may_be_connected(sv)) {
+    sv->stats.nb_backtracks++;
     return;
   }
+  if (depth == 0)
+    for (uint k = 0; k < sv->size; k++)
+      if (_popcount4(_initial_domain(sv->shapes[k])) > 1 && _popcount4(sv->domains[k]) == 1) sv->stats.nb_propagated++;
 
-  uint i = pos / g->nb_cols;
-  uint j = pos % g->nb_cols;
+  // branch on the square with the smallest domain
+  uint best = sv->size, best_size = NB_DIRS + 1;
+  for (uint k = 0; k < sv->size && best_size > 2; k++) {
+    uint size = _popcount4(sv->domains[k]);
+    if (size > 1 && size < best_size) {
+      best = k;
+      best_size = size;
+    }
+  }
+  if (best == sv->size) {
+    // every square is fixed, and connected: this is a solution
+    unsigned char* sol = (sv->stats.nb_solutions == 0) ? sv->solution : (sv->stats.nb_solutions == 1) ? sv->other : NULL;
+    if (sol)
+      for (uint k = 0; k < sv->size; k++) sol[k] = _lowest_bit(sv->domains[k]);
+    sv->stats.nb_solutions++;
+    return;
+  }
+
+  sv->stats.nb_branches++;
+  if (depth + 1 > sv->stats.max_depth) sv->stats.max_depth = depth + 1;
+  unsigned char dom = sv->domains[best];
+  for (uint o = 0; o < NB_DIRS; o++) {
+    if (!(dom & (1 << o))) continue;
+    uint mark = sv->trail_size;
+    _set_domain(sv, best, 1 << o);
+    _search(sv, depth + 1);
+    _undo(sv, mark);
+    if (sv->stopped || (sv->max > 0 && sv->stats.nb_solutions >= sv->max)) return;
+  }
+}
 
-  shape s = game_get_piece_shape(g, i, j);
-  direction initial_orientation = game_get_piece_orientation(g, i, j);
+/** approximation of log2(1 + x), exact on powers of 2 and linear in between */
+static double _log2_1p(uint x) {
+  x++;
+  uint e = 0;
+  while ((x >> e) > 1) e++;
+  return e + (double)(x - (1u << e)) / (1u << e);
+}
+
+/** run a new search, stopping after max solutions (0 = no limit) */
+static void _solver_run(solver* sv, uint max) {
+  _solver_reset(sv, max);
+  _search(sv, 0);
+  game_stats* st = &sv->stats;
+  double unsolved = st->nb_squares ? (double)(st->nb_squares - st->nb_propagated) / st->nb_squares : 0.0;
+  st->difficulty = 100.0 * unsolved + 10.0 * _log2_1p(st->nb_branches) + 10.0 * _log2_1p(st->nb_backtracks);
+}
 
-  int nb_directions = (s == SEGMENT) ? 2 : (s == CROSS || s == EMPTY) ? 1 : NB_DIRS;
+/** run the solver on g, reporting the progress to the callback (if not NULL) */
+static void _solve_progress(cgame g, uint max, solver_progress progress, void* data, solver* sv) {
+  _solver_alloc(sv, g->nb_rows, g->nb_cols, g->wrapping);
+  for (uint k = 0; k < sv->size; k++) sv->shapes[k] = g->squares[k].s;
+  sv->progress = progress;
+  sv->progress_data = data;
+  _solver_run(sv, max);
+}
 
-  for (int k = 0; k < nb_directions; k++) {
-    direction new_orientation = (initial_orientation + k) % NB_DIRS;
-    game_set_piece_orientation(g, i, j, new_orientation);
-    if (check(g, pos)) {
-      solve_rec(g, pos + 1, onlyfirst, size, cpt);
-      if (onlyfirst && *cpt > 0) return;  // Arrêter dès qu'on trouve une solution
+/** run the solver on g */
+static void _solve(cgame g, uint max, solver* sv) { _solve_progress(g, max, NULL, NULL, sv); }
+
+/* ************************************************************************** */
+
+uint game_nb_solutions(cgame g) { return game_nb_solutions_max(g, 0); }
+
+uint game_nb_solutions_max(cgame g, uint max) { return game_nb_solutions_ext(g, max, NULL); }
+
+uint game_nb_solutions_ext(cgame g, uint max, game_stats* stats) {
+  assert(g);
+  solver sv;
+  _solve(g, max, &sv);
+  uint nb_sol = sv.stats.nb_solutions;
+  if (stats) *stats = sv.stats;
+  _solver_free(&sv);
+  return nb_sol;
+}
+
+bool game_solve(game g) { return game_solve_ext(g, NULL); }
+
+bool game_solve_ext(game g, game_stats* stats) { return game_solve_progress(g, NULL, NULL, stats); }
+
+bool game_solve_progress(game g, solver_progress progress, void* data, game_stats* stats) {
+  assert(g);
+  solver sv;
+  _solve_progress(g, 1, progress, data, &sv);
+  bool found = !sv.stopped && sv.stats.nb_solutions > 0;
+  if (found) {
+    for (uint k = 0; k < sv.size; k++) g->squares[k].o = sv.solution[k];
+    _journal_orientations(g, false);
+  }
+  if (stats) *stats = sv.stats;
+  _solver_free(&sv);
+  return found;
+}
+
+bool game_grade(cgame g, game_stats* stats) {
+  assert(g && stats);
+  solver sv;
+  _solve(g, 2, &sv);
+  *stats = sv.stats;
+  _solver_free(&sv);
+  return stats->nb_solutions > 0;
+}
+
+game game_random_graded(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, double min_difficulty,
+                        double max_difficulty, uint nb_tries, prng* rng, game_stats* stats) {
+  for (uint t = 0; t < nb_tries; t++) {
+    game g = game_random_ext(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, rng);
+    if (g == NULL) return NULL;
+    game_stats st;
+    game_grade(g, &st);
+    if (st.difficulty >= min_difficulty && st.difficulty <= max_difficulty) {
+      if (stats) *stats = st;
+      return g;
     }
+    game_delete(g);
   }
-  game_set_piece_orientation(g, i, j, initial_orientation);
+  return NULL;
 }
 
-uint game_nb_solutions(cgame g) {
-  game g_cpy = game_copy(g);
-  uint cpt = 0;
-  uint size = g->nb_rows * g->nb_cols;
-  printf("Début de la recherche de solutions : %dx%d\n", g->nb_rows, g->nb_cols);
-  solve_rec(g_cpy, 0, false, size, &cpt);
-  game_delete(g_cpy);
-  return cpt;
+/* ************************************************************************** */
+/*                              UNIQUE PUZZLES                                */
+/* ************************************************************************** */
+
+/* A random network usually has several solutions, because some groups of
+ * pieces can be turned together. Instead of drawing new networks until one is
+ * unique, the network is locally rewired where two solutions disagree: an edge
+ * is added from a square where they differ, which closes a cycle, and a random
+ * edge of this cycle is removed. The network stays connected, and the numbers
+ * of empty squares and of edges do not change. */
+
+#define NB_RESTARTS 100
+
+/** rewire the network around a square where it differs from the solution alt,
+ * return false if no edge can be added there */
+static bool _rewire(solver* sv, unsigned char* codes, const unsigned char* alt, uint* candidates, uint32_t* from,
+                    prng* rng) {
+  // edges that could be added from a square where the solutions differ
+  uint nb_candidates = 0;
+  for (uint k = 0; k < sv->size; k++) {
+    if (codes[k] == 0 || _code[sv->shapes[k]][alt[k]] == codes[k]) continue;
+    for (direction d = 0; d < NB_DIRS; d++) {
+      uint32_t next = sv->neighbors[4 * k + d];
+      if (!(codes[k] & (0x8 >> d)) && next != NO_NEIGHBOR && next != k && codes[next] != 0)
+        candidates[nb_candidates++] = 4 * k + d;
+    }
+  }
+  if (nb_candidates == 0) return false;
+  uint c = candidates[prng_uniform(rng, nb_candidates)];
+  uint start = c / 4, end = sv->neighbors[c];
+  direction dir = c % 4;
+
+  // find the path from start to end in the network (BFS)
+  memset(sv->seen, 0, sv->size * sizeof(bool));
+  uint head = 0, tail = 0;
+  sv->bfs[tail++] = start;
+  sv->seen[start] = true;
+  while (head < tail && !sv->seen[end]) {
+    uint k = sv->bfs[head++];
+    for (direction d = 0; d < NB_DIRS; d++) {
+      uint32_t next = sv->neighbors[4 * k + d];
+      if (!(codes[k] & (0x8 >> d)) || sv->seen[next]) continue;
+      sv->seen[next] = true;
+      from[next] = 4 * k + d;  // edge used to reach next
+      sv->bfs[tail++] = next;
+    }
+  }
+  assert(sv->seen[end]);  // the network is connected
+
+  // remove a random edge of the path, then close the cycle
+  uint length = 0;
+  for (uint k = end; k != start; k = from[k] / 4) length++;
+  uint r = prng_uniform(rng, length), k = end;
+  for (uint l = 0; l < r; l++) k = from[k] / 4;
+  uint prev = from[k] / 4;
+  direction d = from[k] % 4;
+  codes[prev] &= ~(0x8 >> d);
+  codes[k] &= ~(0x8 >> OPPOSITE_DIR(d));
+  _link(codes, start, end, dir);
+  return true;
 }
 
-bool game_solve(game g) {
-  uint size = g->nb_rows * g->nb_cols;
-  uint cpt = 0;
-  solve_rec(g, 0, true, size, &cpt);  // Trouver une seule solution
-  if (cpt > 0) {
-    printf("Une solution a été trouvée !\n");
-    return true;
-  } else {
-    printf("Aucune solution trouvée.\n");
-    return false;
+game game_random_unique(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, prng* rng) {
+  assert(rng);
+  unsigned char* codes = _random_codes(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, rng);
+  if (codes == NULL) return NULL;
+  uint size = nb_rows * nb_cols;
+  solver sv;
+  _solver_alloc(&sv, nb_rows, nb_cols, wrapping);
+  uint* candidates = _game_malloc(ALLOC_GENERATOR, 4 * size * sizeof(uint));
+  uint32_t* from = _game_malloc(ALLOC_GENERATOR, size * sizeof(uint32_t));
+  assert(candidates && from);
+
+  game g = NULL;
+  for (uint r = 0; r < NB_RESTARTS && codes && !g; r++) {
+    for (uint t = 0; t < 4 * size + 100; t++) {
+      // the shapes change at each step, so each search starts from scratch
+      for (uint k = 0; k < size; k++) sv.shapes[k] = _code2shape[codes[k]];
+      _solver_run(&sv, 2);
+      assert(sv.stats.nb_solutions > 0);  // the network itself is a solution
+      if (sv.stats.nb_solutions == 1) {
+        g = _codes2game(nb_rows, nb_cols, wrapping, codes);
+        break;
+      }
+      // at least one of the two solutions differs from the network
+      const unsigned char* alt = sv.other;
+      for (uint k = 0; k < size; k++)
+        if (_code[sv.shapes[k]][sv.solution[k]] != codes[k]) {
+          alt = sv.solution;
+          break;
+        }
+      if (!_rewire(&sv, codes, alt, candidates, from, rng)) break;
+    }
+    if (!g) {
+      _game_free(codes);
+      codes = _random_codes(nb_rows, nb_cols, wrapping, nb_empty, nb_extra, rng);
+    }
   }
-}
\ No newline at end of file
+
+  _game_free(codes);
+  _game_free(candidates);
+  _game_free(from);
+  _solver_free(&sv);
+  return g;
+}
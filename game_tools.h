@@ -13,6 +13,7 @@
 
 #include "game.h"
 #include "game_ext.h"
+#include "prng.h"
 
 /**
  * @name Game Tools
@@ -20,23 +21,192 @@
  */
 
 /**
- * @brief Creates a game by loading its description from a text file.
- * @details See details in the file format description.
+ * @brief Statistics collected by the solver while grading a game.
+ * @details See @ref game_grade. The limit of nb_solutions depends on the
+ * function that filled the statistics: 2 for @ref game_grade, 1 for @ref
+ * game_solve_ext and @ref game_solve_progress, and the given maximum for @ref
+ * game_nb_solutions_ext.
+ **/
+typedef struct {
+  uint nb_squares;    /**< number of squares with several distinct orientations */
+  uint nb_propagated; /**< number of those squares fixed by propagation alone */
+  uint nb_branches;   /**< number of branch points */
+  uint max_depth;     /**< maximum number of nested branch points */
+  uint nb_backtracks; /**< number of dead ends */
+  uint nb_nodes;      /**< number of nodes in the search tree */
+  uint nb_solutions;  /**< number of solutions found, up to the limit of the search */
+  double difficulty;  /**< difficulty score */
+} game_stats;
+
+/**
+ * @brief Status of a game loading.
+ **/
+typedef enum {
+  LOAD_OK = 0,          /**< no error */
+  LOAD_ERR_OPEN,        /**< the file cannot be opened or read */
+  LOAD_ERR_HEADER,      /**< invalid header */
+  LOAD_ERR_SHAPE,       /**< invalid shape letter */
+  LOAD_ERR_ORIENTATION, /**< invalid orientation letter */
+  LOAD_ERR_TRUNCATED,   /**< the file ends before the last square */
+  LOAD_ERR_VERSION,     /**< unsupported version of the binary format */
+  LOAD_ERR_CHECKSUM,    /**< corrupted squares in the binary format */
+  LOAD_ERR_RECORD,      /**< invalid record in a journal */
+} load_status;
+
+/**
+ * @brief Error reported by a game loading.
+ **/
+typedef struct {
+  load_status status; /**< what went wrong */
+  uint line;          /**< line of the error, starting at 1 (0 for the binary format) */
+  uint col;           /**< column of the error, starting at 1 (byte offset + 1 for the binary format) */
+} load_error;
+
+/**
+ * @brief Creates a game by loading its description from a file.
+ * @details See details in the file format description. Both the text and the
+ * binary formats are accepted, as well as grid files: they are recognized by
+ * their magic number.
  * @param filename input file
- * @return the loaded game
+ * @return the loaded game, or NULL if the file cannot be loaded
  **/
 game game_load(char *filename);
 
+/**
+ * @brief Creates a game by loading its description from a file, with error
+ * reporting.
+ * @details The file is mapped in memory and parsed by @ref
+ * game_load_from_buffer.
+ * @param filename input file
+ * @param err if not NULL, filled with the status of the loading
+ * @return the loaded game, or NULL if the file cannot be loaded
+ **/
+game game_load_ext(char *filename, load_error *err);
+
+/**
+ * @brief Opens a grid file, working directly on the squares it stores.
+ * @details The file must be in the grid format (see @ref game_save_grid). It
+ * is mapped in memory instead of being loaded, so opening is immediate and the
+ * squares are only read from the disk when they are used. All the functions on
+ * games work as usual. With a writable mapping, every change of the squares is
+ * written to the file, without calling a save function; otherwise the changes
+ * are lost when the game is deleted. The file is unmapped by @ref game_delete.
+ * Only the header is checked, the squares are trusted (use @ref game_load to
+ * check a file of unknown origin).
+ * @param filename the grid file
+ * @param writable whether the changes are written to the file
+ * @return the game, or NULL if the file cannot be mapped or is not a grid file
+ **/
+game game_map_file(char *filename, bool writable);
+
+/**
+ * @brief Creates a game from its description in memory.
+ * @details The buffer holds the content of a text or binary file, see the
+ * file format description. It does not need to be null-terminated. Anything after the last
+ * square is ignored.
+ * @param buffer the content to parse
+ * @param size the size of the content, in bytes
+ * @param err if not NULL, filled with the status of the loading, and the line
+ * and column of the error
+ * @return the loaded game, or NULL if the content is invalid
+ **/
+game game_load_from_buffer(const char *buffer, size_t size, load_error *err);
+
+/**
+ * @brief Describes a loading status.
+ * @param status the status
+ * @return a static string describing the status
+ **/
+const char *game_load_error_message(load_status status);
+
 /**
  * @brief Saves a game in a text file.
- * @details See details the file format description.
+ * @details See details the file format description. The content is written
+ * with a single system call to a temporary file, which is then renamed, so the
+ * file is never left truncated.
+ * @param g game to save
+ * @param filename output file
+ * @return true if the game is saved, false otherwise
+ **/
+bool game_save(cgame g, char *filename);
+
+/**
+ * @brief Writes a game to an open text stream.
+ * @details Same format as @ref game_save, so several games can be streamed
+ * one after the other into a single file.
+ * @param g game to save
+ * @param file output stream, left open
+ * @return true if the game is written, false otherwise
+ **/
+bool game_save_file(cgame g, FILE *file);
+
+/**
+ * @brief Writes the text description of a game in memory.
+ * @details Same format as @ref game_save. The buffer is null-terminated.
+ * @param g game to save
+ * @param size filled with the size of the description, without the final null
+ * character
+ * @return a buffer to release with free(), or NULL if there is not enough
+ * memory
+ **/
+char *game_save_to_buffer(cgame g, size_t *size);
+
+/**
+ * @brief Saves a game in a binary file.
+ * @details The binary format starts with a 20-byte header: the magic number
+ * "NETG", the format version, the wrapping option, flags, the numbers of rows
+ * and columns and a checksum of the squares. Then each square takes a single
+ * byte. The file is written atomically, like with @ref game_save.
+ * @param g game to save
+ * @param filename output file
+ * @return true if the game is saved, false otherwise
+ **/
+bool game_save_binary(cgame g, char *filename);
+
+/**
+ * @brief Writes a game in the binary format to an open stream.
+ * @param g game to save
+ * @param file output stream, left open
+ * @return true if the game is written, false otherwise
+ **/
+bool game_save_binary_file(cgame g, FILE *file);
+
+/**
+ * @brief Writes the binary description of a game in memory.
+ * @param g game to save
+ * @param size filled with the size of the description, in bytes
+ * @return a buffer to release with free(), or NULL if there is not enough
+ * memory
+ **/
+char *game_save_binary_to_buffer(cgame g, size_t *size);
+
+/**
+ * @brief Saves a game in a grid file, to be opened by @ref game_map_file.
+ * @details The grid format starts with a 16-byte header: the magic number
+ * "NETM", the format version, the wrapping option, flags and the numbers of
+ * rows and columns. Then each square takes two bytes, its shape and its
+ * orientation, as in memory. Grid files can also be loaded with @ref
+ * game_load. The file is written atomically, like with @ref game_save.
  * @param g game to save
  * @param filename output file
+ * @return true if the game is saved, false otherwise
+ **/
+bool game_save_grid(cgame g, char *filename);
+
+/**
+ * @brief Writes the grid description of a game in memory.
+ * @param g game to save
+ * @param size filled with the size of the description, in bytes
+ * @return a buffer to release with free(), or NULL if there is not enough
+ * memory
  **/
-void game_save(cgame g, char *filename);
+char *game_save_grid_to_buffer(cgame g, size_t *size);
 
 /**
  * @brief Creates a random game solution with a given size and options.
+ * @details The network is a random spanning tree over the non-empty squares,
+ * built in linear time, plus the extra edges. The generation never fails when
+ * the preconditions hold.
  * @param nb_rows number of rows in game
  * @param nb_cols number of columns in game
  * @param wrapping wrapping option
@@ -46,10 +216,44 @@ void game_save(cgame g, char *filename);
  * @pre nb_empty <= (nb_cols * nb_rows - 2)
  * @pre nb_extra must be small enough compared to the number of non-empty
  * squares
- * @return the generated random game (or NULL in case of error)
+ * @return the generated random game (or NULL if the preconditions are not met)
  */
 game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra);
 
+/**
+ * @brief Creates a random game solution, using a given random generator.
+ * @details Same as @ref game_random, but all the random numbers are drawn from
+ * @p rng. The result only depends on the parameters and on the state of
+ * @p rng, and several games can be generated concurrently with distinct
+ * generators.
+ * @param nb_rows number of rows in game
+ * @param nb_cols number of columns in game
+ * @param wrapping wrapping option
+ * @param nb_empty number of empty squares
+ * @param nb_extra number of extra edges, that make cycles (if possible)
+ * @param rng the random generator
+ * @pre @p rng must be an initialized generator.
+ * @return the generated random game (or NULL if the preconditions are not met)
+ */
+game game_random_ext(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, prng* rng);
+
+/**
+ * @brief Creates a random game solution, whose puzzle has a unique solution.
+ * @details The network is generated as in @ref game_random_ext, then rewired
+ * locally where the solver finds two different solutions, until the solution
+ * is unique. The number of empty squares and the number of edges are the same
+ * as in @ref game_random_ext.
+ * @param nb_rows number of rows in game
+ * @param nb_cols number of columns in game
+ * @param wrapping wrapping option
+ * @param nb_empty number of empty squares
+ * @param nb_extra number of extra edges, that make cycles (if possible)
+ * @param rng the random generator
+ * @return the generated game, or NULL if the preconditions of
+ * @ref game_random_ext are not met or if no unique game could be found
+ */
+game game_random_unique(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, prng *rng);
+
 /**
  * @}
  */
@@ -63,6 +267,42 @@ game game_random(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint
  */
 bool game_solve(game g);
 
+/**
+ * @brief Computes the solution of a given game, and reports the solver effort.
+ * @details Same as @ref game_solve, the solver stopping at the first solution.
+ * The statistics are the ones of @ref game_grade, except that @p
+ * stats->nb_solutions is at most 1 and the difficulty is not meaningful when
+ * the search stops early.
+ * @param g the game to solve
+ * @param stats if not NULL, filled with the solver statistics
+ * @return true if a solution is found, false otherwise
+ */
+bool game_solve_ext(game g, game_stats *stats);
+
+/**
+ * @brief Progress callback of the solver.
+ * @details Called with the current statistics of the search at its first node,
+ * then every @ref SOLVER_PROGRESS_NODES nodes.
+ * @return false to stop the search
+ */
+typedef bool (*solver_progress)(const game_stats *stats, void *data);
+
+/** @brief Number of nodes explored between two calls of the progress callback. */
+#define SOLVER_PROGRESS_NODES 4096
+
+/**
+ * @brief Computes the solution of a given game, reporting the progress.
+ * @details Same as @ref game_solve_ext, the callback being called during the
+ * search, which may stop it (e.g. for a solver running in another thread).
+ * @param g the game to solve
+ * @param progress the progress callback, or NULL
+ * @param data passed to the callback
+ * @param stats if not NULL, filled with the solver statistics
+ * @return true if a solution is found, false otherwise or if the search is
+ * stopped (@p g being unchanged)
+ */
+bool game_solve_progress(game g, solver_progress progress, void *data, game_stats *stats);
+
 /**
  * @brief Computes the total number of solutions of a given game.
  * @param g the game
@@ -74,6 +314,66 @@ bool game_solve(game g);
 
 uint game_nb_solutions(cgame g);
 
+/**
+ * @brief Counts the solutions of a given game, up to a limit.
+ * @details Same as @ref game_nb_solutions, but the search stops as soon as
+ * @p max solutions are found, e.g. max = 2 is enough to check that a game has
+ * a unique solution. A limit of 0 means no limit.
+ * @param g the game
+ * @param max maximum number of solutions to count
+ * @post The game @p g must be unchanged.
+ * @return the number of solutions, at most @p max
+ */
+uint game_nb_solutions_max(cgame g, uint max);
+
+/**
+ * @brief Counts the solutions of a given game, and reports the solver effort.
+ * @details Same as @ref game_nb_solutions_max. The statistics are the ones of
+ * @ref game_grade, except that @p stats->nb_solutions is not limited to 2.
+ * @param g the game
+ * @param max maximum number of solutions to count (0 means no limit)
+ * @param stats if not NULL, filled with the solver statistics
+ * @post The game @p g must be unchanged.
+ * @return the number of solutions, at most @p max
+ */
+uint game_nb_solutions_ext(cgame g, uint max, game_stats *stats);
+
+/**
+ * @brief Grades the difficulty of a given game.
+ * @details The solver looks for up to 2 solutions, in order to prove that the
+ * solution is unique, and records its effort in @p stats. The difficulty score
+ * is 0 for a game solved by propagation alone. It adds up the percentage of
+ * squares that propagation alone cannot fix, and 10 * log2(1 + x) for the
+ * number of branch points and for the number of backtracks. The orientations of
+ * the pieces in @p g are ignored.
+ * @param g the game
+ * @param stats the solver statistics, filled by this function
+ * @post The game @p g must be unchanged.
+ * @return true if the game has a solution, false otherwise
+ */
+bool game_grade(cgame g, game_stats *stats);
+
+/**
+ * @brief Creates a random game solution, with a difficulty in a given band.
+ * @details Generates random games with @ref game_random_ext and grades them
+ * with @ref game_grade, until the difficulty is between @p min_difficulty and
+ * @p max_difficulty (both included).
+ * @param nb_rows number of rows in game
+ * @param nb_cols number of columns in game
+ * @param wrapping wrapping option
+ * @param nb_empty number of empty squares
+ * @param nb_extra number of extra edges, that make cycles (if possible)
+ * @param min_difficulty minimal difficulty
+ * @param max_difficulty maximal difficulty
+ * @param nb_tries maximal number of games to generate
+ * @param rng the random generator
+ * @param stats if not NULL, filled with the statistics of the returned game
+ * @return the generated game, or NULL if the preconditions of
+ * @ref game_random_ext are not met or if no game fits after @p nb_tries tries
+ */
+game game_random_graded(uint nb_rows, uint nb_cols, bool wrapping, uint nb_empty, uint nb_extra, double min_difficulty,
+                        double max_difficulty, uint nb_tries, prng *rng, game_stats *stats);
+
 /**
  * @}
  */
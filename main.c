@@ -31,12 +31,16 @@ int main(int argc, char* argv[]) {
   SDL_Event e;
   bool quit = false;
   while (!quit) {
-    /* manage events */
-    while (SDL_PollEvent(&e)) {
+    /* sleep until an event comes, then manage all the pending ones */
+    if (!SDL_WaitEvent(&e)) ERROR("Error: SDL_WaitEvent (%s)", SDL_GetError());
+    do {
       /* process your events */
       quit = process(win, ren, env, &e);
-      if (quit) break;
-    }
+    } while (!quit && SDL_PollEvent(&e));
+    if (quit) break;
+
+    /* redraw only when something has changed */
+    if (!need_render(env)) continue;
 
     /* background in gray */
     SDL_SetRenderDrawColor(ren, 0xA0, 0xA0, 0xA0, 0xFF);
@@ -45,7 +49,6 @@ int main(int argc, char* argv[]) {
     /* render all what you want */
     render(win, ren, env);
     SDL_RenderPresent(ren);
-    SDL_Delay(DELAY);
   }
 
   /* clean your environment */
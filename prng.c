@@ -0,0 +1,77 @@
+/**
+ * @file prng.c
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#include "prng.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+/* ************************************************************************** */
+
+static inline uint64_t _rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+/* ************************************************************************** */
+
+/** splitmix64, used to expand the seed into the 256-bit state */
+static uint64_t _splitmix64(uint64_t* x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* ************************************************************************** */
+
+void prng_seed(prng* r, uint64_t seed) {
+  assert(r);
+  for (int k = 0; k < 4; k++) r->s[k] = _splitmix64(&seed);
+}
+
+/* ************************************************************************** */
+
+uint64_t prng_next(prng* r) {
+  uint64_t* s = r->s;
+  uint64_t result = _rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = _rotl(s[3], 45);
+  return result;
+}
+
+/* ************************************************************************** */
+
+unsigned int prng_uniform(prng* r, unsigned int n) {
+  assert(n > 0);
+  uint64_t m = (prng_next(r) >> 32) * n;
+  uint32_t low = (uint32_t)m;
+  if (low < n) {
+    uint32_t threshold = (uint32_t)(-n) % n;
+    while (low < threshold) {
+      m = (prng_next(r) >> 32) * n;
+      low = (uint32_t)m;
+    }
+  }
+  return (unsigned int)(m >> 32);
+}
+
+/* ************************************************************************** */
+
+void prng_jump(prng* r) {
+  static const uint64_t jump[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+  uint64_t s[4] = {0, 0, 0, 0};
+  for (int i = 0; i < 4; i++)
+    for (int b = 0; b < 64; b++) {
+      if (jump[i] & ((uint64_t)1 << b))
+        for (int k = 0; k < 4; k++) s[k] ^= r->s[k];
+      prng_next(r);
+    }
+  for (int k = 0; k < 4; k++) r->s[k] = s[k];
+}
+
+/* ************************************************************************** */
@@ -0,0 +1,56 @@
+/**
+ * @file prng.h
+ * @brief Reentrant pseudo-random number generator (xoshiro256**).
+ * @details The whole state is stored in a small structure that is passed
+ * explicitly, so that several threads can draw numbers independently. See
+ * https://prng.di.unimi.it/ for details on the algorithm.
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#ifndef __PRNG_H__
+#define __PRNG_H__
+
+#include <stdint.h>
+
+/**
+ * @brief Generator state.
+ * @details The state must be initialized with @ref prng_seed before use.
+ **/
+typedef struct prng_s {
+  uint64_t s[4]; /**< internal state, never all zero */
+} prng;
+
+/**
+ * @brief Initializes a generator from a seed.
+ * @details The same seed always gives the same sequence of numbers.
+ * @param r the generator
+ * @param seed any 64-bit value
+ **/
+void prng_seed(prng* r, uint64_t seed);
+
+/**
+ * @brief Draws the next 64-bit random number.
+ * @param r the generator
+ * @return a uniformly distributed 64-bit number
+ **/
+uint64_t prng_next(prng* r);
+
+/**
+ * @brief Draws a random integer in [0, n).
+ * @details The result is unbiased (Lemire's multiply-and-reject method).
+ * @param r the generator
+ * @param n the upper bound
+ * @pre @p n > 0
+ * @return a uniformly distributed integer in [0, n)
+ **/
+unsigned int prng_uniform(prng* r, unsigned int n);
+
+/**
+ * @brief Advances the generator by 2^128 steps.
+ * @details Calling this function k times on copies of the same generator gives
+ * k non-overlapping streams, e.g. one for each parallel worker.
+ * @param r the generator
+ **/
+void prng_jump(prng* r);
+
+#endif  // __PRNG_H__
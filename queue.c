@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#include "game_private.h"
+
 /* *********************************************************** */
 
 struct queue_s {
@@ -28,7 +30,7 @@ typedef struct element_s element_t;
 /* *********************************************************** */
 
 queue* queue_new() {
-  queue* q = malloc(sizeof(queue));
+  queue* q = _game_malloc(ALLOC_QUEUE, sizeof(queue));
   assert(q);
   q->length = 0;
   q->tail = q->head = NULL;
@@ -39,7 +41,7 @@ queue* queue_new() {
 
 void queue_push_head(queue* q, void* data) {
   assert(q);
-  element_t* e = malloc(sizeof(element_t));
+  element_t* e = _game_malloc(ALLOC_QUEUE, sizeof(element_t));
   assert(e);
   e->data = data;
   e->prev = NULL;
@@ -54,7 +56,7 @@ void queue_push_head(queue* q, void* data) {
 
 void queue_push_tail(queue* q, void* data) {
   assert(q);
-  element_t* e = malloc(sizeof(element_t));
+  element_t* e = _game_malloc(ALLOC_QUEUE, sizeof(element_t));
   assert(e);
   e->data = data;
   e->prev = q->tail;
@@ -74,7 +76,7 @@ void* queue_pop_head(queue* q) {
   void* data = q->head->data;
   element_t* next = q->head->next;
   if (next) next->prev = NULL;
-  free(q->head);
+  _game_free(q->head);
   q->head = next;
   q->length--;
   if (!q->head) q->tail = NULL;  // empty list
@@ -90,7 +92,7 @@ void* queue_pop_tail(queue* q) {
   void* data = q->tail->data;
   element_t* prev = q->tail->prev;
   if (prev) prev->next = NULL;
-  free(q->tail);
+  _game_free(q->tail);
   q->tail = prev;
   q->length--;
   if (!q->tail) q->head = NULL;  // empty list
@@ -113,6 +115,23 @@ bool queue_is_empty(const queue* q) {
 
 /* *********************************************************** */
 
+void queue_move_head(queue* from, queue* to) {
+  assert(from && to);
+  assert(from->head);
+  element_t* e = from->head;
+  from->head = e->next;
+  if (from->head) from->head->prev = NULL;
+  if (!from->head) from->tail = NULL;  // empty list
+  from->length--;
+  e->next = to->head;
+  if (to->head) to->head->prev = e;
+  to->head = e;
+  if (!to->tail) to->tail = e;
+  to->length++;
+}
+
+/* *********************************************************** */
+
 void* queue_peek_head(queue* q) {
   assert(q);
   assert(q->head);
@@ -135,7 +154,7 @@ void queue_clear(queue* q) {
   while (e) {
     element_t* tmp = e;
     e = e->next;
-    free(tmp);
+    _game_free(tmp);
   }
   q->head = q->tail = NULL;
   q->length = 0;
@@ -150,7 +169,7 @@ void queue_clear_full(queue* q, void (*destroy)(void*)) {
     element_t* tmp = e;
     if (destroy) destroy(e->data);
     e = e->next;
-    free(tmp);
+    _game_free(tmp);
   }
   q->head = q->tail = NULL;
   q->length = 0;
@@ -160,14 +179,14 @@ void queue_clear_full(queue* q, void (*destroy)(void*)) {
 
 void queue_free(queue* q) {
   queue_clear(q);
-  free(q);
+  _game_free(q);
 }
 
 /* *********************************************************** */
 
 void queue_free_full(queue* q, void (*destroy)(void*)) {
   queue_clear_full(q, destroy);
-  free(q);
+  _game_free(q);
 }
 
 /* *********************************************************** */
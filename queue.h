@@ -34,6 +34,10 @@ queue is empty). The returned element must be freed manually if it was
 dynamically allocated. */
 void* queue_pop_tail(queue* q);
 
+/** Moves the first element of the queue from, with its data, at the head of
+the queue to, without any allocation. The queue from must not be empty. */
+void queue_move_head(queue* from, queue* to);
+
 /** Returns the number of elements in queue. */
 int queue_length(const queue* q);
 
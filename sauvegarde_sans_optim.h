@@ -0,0 +1,39 @@
+/**
+ * @file sauvegarde_sans_optim.h
+ * @brief Baseline solver, without any optimization.
+ * @details The first version of the solver, which tries every orientation of
+ * every square and checks the game once they are all set. It is exponential
+ * in the number of squares, and is only meant to check the results of @ref
+ * game_solve and @ref game_nb_solutions on small games.
+ * @copyright University of Bordeaux. All rights reserved, 2024.
+ **/
+
+#ifndef __SAUVEGARDE_SANS_OPTIM_H__
+#define __SAUVEGARDE_SANS_OPTIM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+
+/**
+ * @brief Counts the solutions of a game with the baseline solver.
+ * @details Solutions with pieces in symmetrical positions (SEGMENT or CROSS)
+ * are counted only once, as in @ref game_nb_solutions.
+ * @param g the game
+ * @param nodes filled with the number of nodes of the search tree
+ * @return the number of solutions
+ **/
+uint baseline_nb_solutions(cgame g, uint64_t* nodes);
+
+/**
+ * @brief Solves a game with the baseline solver.
+ * @details The game is updated with the first solution found, in the order of
+ * the orientations; it is unchanged if there is no solution.
+ * @param g the game
+ * @param nodes filled with the number of nodes of the search tree
+ * @return true if a solution is found, false otherwise
+ **/
+bool baseline_solve(game g, uint64_t* nodes);
+
+#endif  // __SAUVEGARDE_SANS_OPTIM_H__
@@ -0,0 +1,146 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "game.h"
+#include "game_aux.h"
+#include "game_ext.h"
+#include "game_tools.h"
+#include "prng.h"
+#include "sauvegarde_sans_optim.h"
+
+/* Runs the baseline solver (sauvegarde_sans_optim.c) and the current one side
+ * by side on a deterministic corpus of small games, checks that they find the
+ * same number of solutions and that both solutions are valid, and reports the
+ * number of nodes and the speedup per game. The corpus is made of random games
+ * of every small size, with and without wrapping, empty squares and extra
+ * edges, shuffled; a third of them get a square with a wrong shape, which
+ * makes most of them unsolvable. The games whose baseline search tree has more
+ * than MAX_LEAVES leaves are skipped. */
+
+#define SEED 41
+#define MAX_LEAVES (1u << 18)
+
+static double _now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/** number of leaves of the baseline search tree */
+static uint64_t _nb_leaves(cgame g) {
+  uint64_t nb = 1;
+  for (uint i = 0; i < game_nb_rows(g); i++)
+    for (uint j = 0; j < game_nb_cols(g); j++) {
+      shape s = game_get_piece_shape(g, i, j);
+      nb *= (s == SEGMENT) ? 2 : (s == CROSS || s == EMPTY) ? 1 : NB_DIRS;
+    }
+  return nb;
+}
+
+/** check that a solved copy of a game is a valid solution of it */
+static bool _valid_solution(cgame g, cgame sol) { return game_equal(g, sol, true) && game_won(sol); }
+
+/* ************************************************************************** */
+
+typedef struct {
+  uint nb_games;
+  uint nb_failures;
+  uint64_t baseline_nodes, current_nodes;
+  double baseline_time, current_time;
+} totals;
+
+/** compare both solvers on a game, and print one line of results */
+static void _compare(cgame g, uint id, totals* t) {
+  uint64_t baseline_nodes;
+  double start = _now();
+  uint baseline_nb = baseline_nb_solutions(g, &baseline_nodes);
+  double baseline_time = _now() - start;
+
+  game_stats stats;
+  start = _now();
+  uint current_nb = game_nb_solutions_ext(g, 0, &stats);
+  double current_time = _now() - start;
+
+  bool ok = (baseline_nb == current_nb);
+  uint64_t solve_nodes;
+  game sol = game_copy(g);
+  bool found = baseline_solve(sol, &solve_nodes);
+  ok = ok && (found == (baseline_nb > 0)) && (found ? _valid_solution(g, sol) : game_equal(g, sol, false));
+  game_delete(sol);
+  sol = game_copy(g);
+  found = game_solve(sol);
+  ok = ok && (found == (current_nb > 0)) && (found ? _valid_solution(g, sol) : game_equal(g, sol, false));
+  game_delete(sol);
+
+  printf("%4u %ux%u %-3s %5u %5u %10llu %8u %10.6f %10.6f %8.1f%s\n", id, game_nb_rows(g), game_nb_cols(g),
+         game_is_wrapping(g) ? "yes" : "no", baseline_nb, current_nb, (unsigned long long)baseline_nodes,
+         stats.nb_nodes, baseline_time, current_time, current_time > 0 ? baseline_time / current_time : 0,
+         ok ? "" : "  FAILED");
+  t->nb_games++;
+  if (!ok) t->nb_failures++;
+  t->baseline_nodes += baseline_nodes;
+  t->current_nodes += stats.nb_nodes;
+  t->baseline_time += baseline_time;
+  t->current_time += current_time;
+}
+
+/* ************************************************************************** */
+
+void usage(char* cmd) {
+  printf("Usage: %s [--seed <n>] [--max-leaves <n>]\n", cmd);
+  printf("Compares the baseline solver with the current one on a corpus of small random games, generated\n");
+  printf("from the seed (default %u), skipping the games with more than <n> leaves to explore for the\n", SEED);
+  printf("baseline (default %u). Fails if the solvers disagree on any game.\n", MAX_LEAVES);
+  printf("Example: %s --seed 7\n", cmd);
+}
+
+int main(int argc, char* argv[]) {
+  static const uint sizes[][2] = {{1, 2}, {2, 2}, {2, 3}, {3, 2}, {2, 4}, {3, 3}, {4, 2}, {3, 4}, {4, 3}, {4, 4}};
+  uint64_t seed = SEED;
+  uint64_t max_leaves = MAX_LEAVES;
+  for (int arg = 1; arg < argc; arg++) {
+    if (strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc) {
+      seed = strtoull(argv[++arg], NULL, 10);
+    } else if (strcmp(argv[arg], "--max-leaves") == 0 && arg + 1 < argc) {
+      max_leaves = strtoull(argv[++arg], NULL, 10);
+    } else {
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  prng rng;
+  prng_seed(&rng, seed);
+  totals t = {0};
+  uint id = 0;
+  printf("  id size wrap   sols  sols  nodes_old nodes_new   time_old   time_new  speedup\n");
+  for (uint s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    for (uint wrapping = 0; wrapping < 2; wrapping++)
+      for (uint nb_empty = 0; nb_empty < 3; nb_empty++)
+        for (uint nb_extra = 0; nb_extra < 3; nb_extra++) {
+          game g = game_random_ext(sizes[s][0], sizes[s][1], wrapping, nb_empty, nb_extra, &rng);
+          if (g == NULL) continue;
+          game_shuffle_orientation_ext(g, &rng);
+          if (id % 3 == 2) {
+            uint k = prng_uniform(&rng, sizes[s][0] * sizes[s][1]);
+            shape old = game_get_piece_shape(g, k / sizes[s][1], k % sizes[s][1]);
+            game_set_piece_shape(g, k / sizes[s][1], k % sizes[s][1], (old + 1 + prng_uniform(&rng, 4)) % NB_SHAPES);
+          }
+          if (_nb_leaves(g) <= max_leaves) _compare(g, id, &t);
+          id++;
+          game_delete(g);
+        }
+
+  printf("%u games, %u failures: %llu nodes for the baseline, %llu for the current solver\n", t.nb_games,
+         t.nb_failures, (unsigned long long)t.baseline_nodes, (unsigned long long)t.current_nodes);
+  printf("total time: %.3f s for the baseline, %.3f s for the current solver, speedup %.1f\n", t.baseline_time,
+         t.current_time, t.current_time > 0 ? t.baseline_time / t.current_time : 0);
+  return t.nb_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}